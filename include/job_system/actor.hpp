@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+#include "job_system.hpp"
+#include "serial_queue.hpp"
+
+// 轻量级Actor:每个Actor有一个SerialQueue邮箱,邮箱由空变为非空时投递一个处理作业,处理作业每次最多处理batch_size条消息.
+// 处理作业优先投递回上次处理该Actor的工作线程,让Actor的状态留在该线程的缓存里.
+// 空闲的Actor不占用线程和队列,只占用自身的内存
+// Receive抛出的异常交给OnException处理,默认保留第一个异常,由TakeException取走;处理作业本身不会抛出
+template<class Message>
+class Actor
+{
+public:
+	static constexpr uint32_t kDefaultBatchSize = 64;
+
+	explicit Actor(JobSystem& job_system = JobSystem::Get(), uint32_t batch_size = kDefaultBatchSize)
+		: job_system_(job_system)
+		, batch_size_(batch_size)
+		, last_worker_index_(JobSystem::kInvalidWorkerIndex)
+	{
+		assert(batch_size >= 1);
+	}
+
+	virtual ~Actor()
+	{
+		assert(mailbox_.GetSize() == 0);
+	}
+
+	Actor(const Actor&) = delete;
+	Actor& operator=(const Actor&) = delete;
+
+	// 可以在任意线程调用
+	void Send(Message message)
+	{
+		auto envelope = new Envelope();
+		envelope->message = std::move(message);
+		if (mailbox_.Push(envelope))
+		{
+			Schedule();
+		}
+	}
+
+	// 尚未处理的消息数量
+	uint32_t GetMailboxSize() const { return mailbox_.GetSize(); }
+
+	// 取走第一个未处理的异常,没有时返回空
+	std::exception_ptr TakeException() { return exception_.Take(); }
+protected:
+	// 同一个Actor的消息按发送顺序逐条处理,不会并发
+	virtual void Receive(Message& message) = 0;
+
+	// Receive处理message时抛出了异常,在Actor上串行调用;返回后继续处理下一条消息
+	virtual void OnException(Message& message, std::exception_ptr exception)
+	{
+		(void)message;
+		exception_.Keep(std::move(exception));
+	}
+private:
+	struct Envelope : MpscNode
+	{
+		Message message;
+	};
+
+	void Schedule()
+	{
+		Job* job = job_system_.CreateJob([this](Job*)
+			{
+				Process();
+			});
+
+		uint32_t worker_index = last_worker_index_.load(std::memory_order_relaxed);
+		if (worker_index == JobSystem::kInvalidWorkerIndex || worker_index == job_system_.GetWorkerIndex())
+		{
+			job_system_.Run(job);
+		}
+		else
+		{
+			job_system_.RunOn(worker_index, job);
+		}
+	}
+
+	void Process()
+	{
+		last_worker_index_.store(job_system_.GetWorkerIndex(), std::memory_order_relaxed);
+
+		bool remaining = mailbox_.Drain(batch_size_, [this](Envelope& envelope)
+			{
+				Receive(envelope.message);
+			}, [this](Envelope& envelope, std::exception_ptr exception)
+			{
+				HandleException(envelope.message, std::move(exception));
+			});
+
+		// 批处理用完,重新排队让出工作线程
+		if (remaining)
+		{
+			Schedule();
+		}
+	}
+
+	void HandleException(Message& message, std::exception_ptr exception)
+	{
+		try
+		{
+			OnException(message, exception);
+		}
+		catch (...)
+		{
+			// 处理函数自己抛出时按默认方式保留
+			Actor::OnException(message, std::current_exception());
+		}
+	}
+
+	JobSystem& job_system_;
+	const uint32_t batch_size_;
+	SerialQueue<Envelope> mailbox_;
+	std::atomic_uint32_t last_worker_index_;
+	FirstException exception_;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#include "../../3rdparty/asio-1.16.1/include/asio.hpp"
+
+#include "job_system.hpp"
+
+class JobExecutor;
+
+// 把JobSystem包装成asio的执行上下文,asio::post(executor, handler)会变成一个作业
+// AttachIoContext之后工作线程空闲时用poll_one处理io_context上的完成事件,网络完成和计算作业共用同一组线程.
+// 被轮询的io_context需要用executor_work_guard保持工作状态,否则没有待处理事件时会自行停止
+class JobExecutionContext : public asio::execution_context
+{
+public:
+	explicit JobExecutionContext(JobSystem& job_system = JobSystem::Get())
+		: job_system_(job_system)
+		, outstanding_work_(0)
+	{
+	}
+
+	~JobExecutionContext()
+	{
+		for (uint32_t id : idle_handler_ids_)
+		{
+			job_system_.RemoveIdleHandler(id);
+		}
+	}
+
+	JobExecutor get_executor() noexcept;
+
+	JobSystem& GetJobSystem() const noexcept { return job_system_; }
+
+	int64_t GetOutstandingWork() const noexcept { return outstanding_work_.load(std::memory_order_relaxed); }
+
+	void AttachIoContext(asio::io_context& io_context)
+	{
+		idle_handler_ids_.push_back(job_system_.AddIdleHandler([&io_context]()
+			{
+				return io_context.poll_one() > 0;
+			}));
+	}
+private:
+	friend class JobExecutor;
+
+	JobSystem& job_system_;
+	std::atomic_int64_t outstanding_work_;
+	std::vector<uint32_t> idle_handler_ids_;
+};
+
+// 满足asio执行器要求(context/on_work_started/on_work_finished/dispatch/post/defer)的JobSystem执行器
+// 可选绑定一个JobCounter,通过该执行器投递的作业全部完成时计数器归零
+class JobExecutor
+{
+public:
+	explicit JobExecutor(JobExecutionContext& context, JobCounter* counter = nullptr) noexcept
+		: context_(&context)
+		, counter_(counter)
+	{
+	}
+
+	JobExecutionContext& context() const noexcept { return *context_; }
+
+	void on_work_started() const noexcept { context_->outstanding_work_.fetch_add(1, std::memory_order_relaxed); }
+
+	void on_work_finished() const noexcept { context_->outstanding_work_.fetch_sub(1, std::memory_order_relaxed); }
+
+	// 已经在工作线程上时直接调用
+	template<class F, class A>
+	void dispatch(F&& f, const A& a) const
+	{
+		if (context_->job_system_.GetWorkerIndex() != JobSystem::kInvalidWorkerIndex)
+		{
+			typename std::decay<F>::type handler(std::forward<F>(f));
+			handler();
+			return;
+		}
+
+		post(std::forward<F>(f), a);
+	}
+
+	template<class F, class A>
+	void post(F&& f, const A& a) const
+	{
+		JobSystem& job_system = context_->job_system_;
+		Job* job = job_system.CreateJob(MakeJobFunction(std::forward<F>(f), a));
+		if (counter_)
+		{
+			job_system.Run(job, counter_);
+		}
+		else
+		{
+			job_system.Run(job);
+		}
+	}
+
+	// 作业压入当前线程队列的底部,本线程会最先取到,与post相同
+	template<class F, class A>
+	void defer(F&& f, const A& a) const
+	{
+		post(std::forward<F>(f), a);
+	}
+
+	friend bool operator==(const JobExecutor& a, const JobExecutor& b) noexcept
+	{
+		return a.context_ == b.context_ && a.counter_ == b.counter_;
+	}
+
+	friend bool operator!=(const JobExecutor& a, const JobExecutor& b) noexcept
+	{
+		return !(a == b);
+	}
+private:
+	// asio的handler可能只能移动,JobFunction要求可拷贝,所以放到共享存储上
+	template<class F, class A>
+	static JobFunction MakeJobFunction(F&& f, const A& a)
+	{
+		using Handler = typename std::decay<F>::type;
+		auto handler = std::allocate_shared<Handler>(a, std::forward<F>(f));
+		return [handler](Job*)
+		{
+			(*handler)();
+		};
+	}
+
+	JobExecutionContext* context_;
+	JobCounter* counter_;
+};
+
+inline JobExecutor JobExecutionContext::get_executor() noexcept
+{
+	return JobExecutor(*this);
+}
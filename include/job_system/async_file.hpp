@@ -0,0 +1,432 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+// 需要5.6及以上的内核头文件:IORING_OP_READ/WRITE是枚举值不能用#if判断,用同一版本加入的IORING_FEAT_RW_CUR_POS代替;
+// IORING_FEAT_SINGLE_MMAP在5.4加入.头文件或系统调用号太旧时编译为只使用阻塞线程池
+#if defined(IORING_FEAT_SINGLE_MMAP) && defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define JOB_SYSTEM_HAS_IO_URING 1
+#else
+#define JOB_SYSTEM_HAS_IO_URING 0
+#endif
+
+#include "job_system.hpp"
+
+#ifdef _WIN32
+using NativeFileHandle = HANDLE;
+#else
+using NativeFileHandle = int;
+#endif
+
+// 完成回调,参数是传输的字节数,失败时是负的错误码
+using AsyncFileCallback = std::function<void(int64_t result)>;
+
+// 异步文件读写,完成回调作为作业投递到JobSystem
+// Linux上通过io_uring批量提交(直接使用系统调用),完成队列由空闲的工作线程收割;
+// io_uring不可用时交给阻塞线程池(RunBlocking)执行同步读写,工作线程不会阻塞在read()上
+class AsyncFileIo
+{
+public:
+	static constexpr uint32_t kDefaultQueueDepth = 256;
+
+	explicit AsyncFileIo(JobSystem& job_system = JobSystem::Get(), uint32_t queue_depth = kDefaultQueueDepth, bool use_io_uring = true);
+
+	// 等待所有请求完成
+	~AsyncFileIo();
+
+	AsyncFileIo(const AsyncFileIo&) = delete;
+	AsyncFileIo& operator=(const AsyncFileIo&) = delete;
+
+	// buffer在回调执行前必须保持有效
+	// 请求先积累起来,调用Submit时一次提交;空闲的工作线程收割完成时也会顺带提交
+	void Read(NativeFileHandle file, void* buffer, uint32_t size, uint64_t offset, AsyncFileCallback callback);
+
+	void Write(NativeFileHandle file, const void* buffer, uint32_t size, uint64_t offset, AsyncFileCallback callback);
+
+	void Submit();
+
+	bool IsUsingIoUring() const { return ring_fd_ >= 0; }
+
+	// 已提交但回调还没投递的请求数量
+	uint32_t GetPendingCount() const { return pending_count_.load(std::memory_order_acquire); }
+private:
+	enum class Operation
+	{
+		kRead,
+		kWrite,
+	};
+
+	struct Request
+	{
+		Operation operation;
+		NativeFileHandle file;
+		void* buffer;
+		uint32_t size;
+		uint64_t offset;
+		AsyncFileCallback callback;
+	};
+
+	void Enqueue(Request* request);
+
+	void Complete(Request* request, int64_t result);
+
+	// 收割完成队列,返回是否收割到完成
+	bool Reap();
+
+	bool SetupIoUring(uint32_t queue_depth);
+
+	void DestroyIoUring();
+
+	void SubmitLocked();
+
+	static int64_t ExecuteSync(const Request& request);
+
+	JobSystem& job_system_;
+	std::atomic_uint32_t pending_count_;
+	uint32_t idle_handler_id_;
+
+	int ring_fd_;
+#if JOB_SYSTEM_HAS_IO_URING
+	std::mutex sq_mutex_;
+	std::mutex cq_mutex_;
+	uint32_t sq_entries_;
+	uint32_t cq_entries_;
+	uint32_t unsubmitted_count_;
+	void* sq_ring_;
+	size_t sq_ring_size_;
+	void* cq_ring_;
+	size_t cq_ring_size_;
+	io_uring_sqe* sqes_;
+	std::atomic_uint32_t* sq_head_;
+	std::atomic_uint32_t* sq_tail_;
+	uint32_t sq_mask_;
+	uint32_t* sq_array_;
+	std::atomic_uint32_t* cq_head_;
+	std::atomic_uint32_t* cq_tail_;
+	uint32_t cq_mask_;
+	io_uring_cqe* cqes_;
+#endif
+};
+
+inline AsyncFileIo::AsyncFileIo(JobSystem& job_system, uint32_t queue_depth, bool use_io_uring)
+	: job_system_(job_system)
+	, pending_count_(0)
+	, idle_handler_id_(0)
+	, ring_fd_(-1)
+{
+	assert(queue_depth >= 1);
+
+	if (use_io_uring && SetupIoUring(queue_depth))
+	{
+		idle_handler_id_ = job_system_.AddIdleHandler([this]()
+			{
+				return Reap();
+			});
+	}
+}
+
+inline AsyncFileIo::~AsyncFileIo()
+{
+	Submit();
+	while (pending_count_.load(std::memory_order_acquire) != 0)
+	{
+		if (!Reap())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (IsUsingIoUring())
+	{
+		job_system_.RemoveIdleHandler(idle_handler_id_);
+		DestroyIoUring();
+	}
+}
+
+inline void AsyncFileIo::Read(NativeFileHandle file, void* buffer, uint32_t size, uint64_t offset, AsyncFileCallback callback)
+{
+	Enqueue(new Request{ Operation::kRead, file, buffer, size, offset, std::move(callback) });
+}
+
+inline void AsyncFileIo::Write(NativeFileHandle file, const void* buffer, uint32_t size, uint64_t offset, AsyncFileCallback callback)
+{
+	Enqueue(new Request{ Operation::kWrite, file, const_cast<void*>(buffer), size, offset, std::move(callback) });
+}
+
+inline void AsyncFileIo::Enqueue(Request* request)
+{
+	pending_count_.fetch_add(1, std::memory_order_acq_rel);
+
+#if JOB_SYSTEM_HAS_IO_URING
+	if (IsUsingIoUring())
+	{
+		std::unique_lock lock(sq_mutex_);
+
+		// 在途请求不能超过完成队列的容量,否则完成会溢出
+		while (pending_count_.load(std::memory_order_acquire) > cq_entries_ || unsubmitted_count_ == sq_entries_)
+		{
+			SubmitLocked();
+			lock.unlock();
+			if (!Reap())
+			{
+				std::this_thread::yield();
+			}
+			lock.lock();
+		}
+
+		uint32_t tail = sq_tail_->load(std::memory_order_relaxed);
+		uint32_t index = tail & sq_mask_;
+		io_uring_sqe* sqe = &sqes_[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = request->operation == Operation::kRead ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe->fd = request->file;
+		sqe->addr = reinterpret_cast<uint64_t>(request->buffer);
+		sqe->len = request->size;
+		sqe->off = request->offset;
+		sqe->user_data = reinterpret_cast<uint64_t>(request);
+		sq_array_[index] = index;
+		sq_tail_->store(tail + 1, std::memory_order_release);
+		++unsubmitted_count_;
+		return;
+	}
+#endif
+
+	job_system_.RunBlocking(job_system_.CreateJob([this, request](Job*)
+		{
+			Complete(request, ExecuteSync(*request));
+		}));
+}
+
+inline void AsyncFileIo::Submit()
+{
+#if JOB_SYSTEM_HAS_IO_URING
+	if (IsUsingIoUring())
+	{
+		std::unique_lock lock(sq_mutex_);
+		SubmitLocked();
+	}
+#endif
+}
+
+inline void AsyncFileIo::SubmitLocked()
+{
+#if JOB_SYSTEM_HAS_IO_URING
+	while (unsubmitted_count_ != 0)
+	{
+		long submitted = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted_count_, 0, 0, nullptr, 0);
+		if (submitted < 0)
+		{
+			// 完成队列暂时满了,交给调用方收割后再重试
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+		unsubmitted_count_ -= static_cast<uint32_t>(submitted);
+	}
+#endif
+}
+
+inline void AsyncFileIo::Complete(Request* request, int64_t result)
+{
+	AsyncFileCallback callback = std::move(request->callback);
+	delete request;
+
+	job_system_.Run(job_system_.CreateJob([callback, result](Job*)
+		{
+			callback(result);
+		}));
+	pending_count_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+inline bool AsyncFileIo::Reap()
+{
+#if JOB_SYSTEM_HAS_IO_URING
+	if (!IsUsingIoUring())
+	{
+		return false;
+	}
+
+	// 顺带提交积累的请求
+	{
+		std::unique_lock lock(sq_mutex_, std::try_to_lock);
+		if (lock && unsubmitted_count_ != 0)
+		{
+			SubmitLocked();
+		}
+	}
+
+	std::unique_lock lock(cq_mutex_, std::try_to_lock);
+	if (!lock)
+	{
+		return false;
+	}
+
+	uint32_t head = cq_head_->load(std::memory_order_relaxed);
+	uint32_t tail = cq_tail_->load(std::memory_order_acquire);
+	if (head == tail)
+	{
+		return false;
+	}
+
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+		Complete(reinterpret_cast<Request*>(cqe.user_data), cqe.res);
+	}
+	cq_head_->store(head, std::memory_order_release);
+	return true;
+#else
+	return false;
+#endif
+}
+
+inline bool AsyncFileIo::SetupIoUring(uint32_t queue_depth)
+{
+#if JOB_SYSTEM_HAS_IO_URING
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// 运行的内核早于5.6时不支持IORING_OP_READ/WRITE,同样退回阻塞线程池
+	if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap)
+	{
+		sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+	}
+
+	sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ring_ == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	cq_ring_ = sq_ring_;
+	if (!single_mmap)
+	{
+		cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ring_ == MAP_FAILED)
+		{
+			munmap(sq_ring_, sq_ring_size_);
+			close(fd);
+			return false;
+		}
+	}
+
+	void* sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		if (!single_mmap)
+		{
+			munmap(cq_ring_, cq_ring_size_);
+		}
+		munmap(sq_ring_, sq_ring_size_);
+		close(fd);
+		return false;
+	}
+
+	char* sq = static_cast<char*>(sq_ring_);
+	char* cq = static_cast<char*>(cq_ring_);
+	sq_head_ = reinterpret_cast<std::atomic_uint32_t*>(sq + params.sq_off.head);
+	sq_tail_ = reinterpret_cast<std::atomic_uint32_t*>(sq + params.sq_off.tail);
+	sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+	sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+	cq_head_ = reinterpret_cast<std::atomic_uint32_t*>(cq + params.cq_off.head);
+	cq_tail_ = reinterpret_cast<std::atomic_uint32_t*>(cq + params.cq_off.tail);
+	cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+	sq_entries_ = params.sq_entries;
+	cq_entries_ = params.cq_entries;
+	unsubmitted_count_ = 0;
+	ring_fd_ = fd;
+	return true;
+#else
+	return false;
+#endif
+}
+
+inline void AsyncFileIo::DestroyIoUring()
+{
+#if JOB_SYSTEM_HAS_IO_URING
+	munmap(sqes_, sq_entries_ * sizeof(io_uring_sqe));
+	if (cq_ring_ != sq_ring_)
+	{
+		munmap(cq_ring_, cq_ring_size_);
+	}
+	munmap(sq_ring_, sq_ring_size_);
+	close(ring_fd_);
+	ring_fd_ = -1;
+#endif
+}
+
+inline int64_t AsyncFileIo::ExecuteSync(const Request& request)
+{
+#ifdef _WIN32
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(request.offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(request.offset >> 32);
+
+	DWORD transferred = 0;
+	BOOL ok = request.operation == Operation::kRead
+		? ReadFile(request.file, request.buffer, request.size, &transferred, &overlapped)
+		: WriteFile(request.file, request.buffer, request.size, &transferred, &overlapped);
+	if (!ok)
+	{
+		DWORD error = GetLastError();
+		return error == ERROR_HANDLE_EOF ? 0 : -static_cast<int64_t>(error);
+	}
+	return transferred;
+#else
+	ssize_t result;
+	do
+	{
+		result = request.operation == Operation::kRead
+			? pread(request.file, request.buffer, request.size, static_cast<off_t>(request.offset))
+			: pwrite(request.file, request.buffer, request.size, static_cast<off_t>(request.offset));
+	} while (result < 0 && errno == EINTR);
+
+	return result < 0 ? -static_cast<int64_t>(errno) : result;
+#endif
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+// ParallelFor2D/3D的分块视图和分块大小
+// 行间距(row_pitch),层间距(slice_pitch)和元素间距(element_stride)都以字节为单位,可以描述带填充的图像或跨步访问的矩阵
+
+// 二维分块:坐标是相对整个范围的下标,At按块内的局部坐标访问
+template<class T>
+struct Tile2D
+{
+	// 指向(row_begin, col_begin)处的元素
+	T* data;
+	uint32_t row_begin;
+	uint32_t col_begin;
+	uint32_t rows;
+	uint32_t cols;
+	size_t row_pitch;
+	size_t element_stride;
+
+	T& At(uint32_t row, uint32_t col) const
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<char*>(data) + row * row_pitch + col * element_stride);
+	}
+
+	// 块内第row行的起始元素,element_stride等于sizeof(T)时该行是连续的
+	T* Row(uint32_t row) const
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<char*>(data) + row * row_pitch);
+	}
+};
+
+template<class T>
+struct Tile3D
+{
+	// 指向(slice_begin, row_begin, col_begin)处的元素
+	T* data;
+	uint32_t slice_begin;
+	uint32_t row_begin;
+	uint32_t col_begin;
+	uint32_t slices;
+	uint32_t rows;
+	uint32_t cols;
+	size_t slice_pitch;
+	size_t row_pitch;
+	size_t element_stride;
+
+	T& At(uint32_t slice, uint32_t row, uint32_t col) const
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<char*>(data) + slice * slice_pitch + row * row_pitch + col * element_stride);
+	}
+
+	T* Row(uint32_t slice, uint32_t row) const
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<char*>(data) + slice * slice_pitch + row * row_pitch);
+	}
+};
+
+// 分块大小(元素数),0表示按缓存大小自动选择
+struct TileSize
+{
+	// 自动选择分块时假定的缓存大小,取常见桌面和服务器处理器每个核心的典型值,并不探测实际硬件;
+	// 缓存更大的机器上分块偏小,只损失少量调度开销
+	static constexpr size_t kL1CacheBytes = 32 * 1024;
+	static constexpr size_t kL2CacheBytes = 256 * 1024;
+	static constexpr size_t kCacheLineBytes = 64;
+
+	uint32_t slices = 0;
+	uint32_t rows = 0;
+	uint32_t cols = 0;
+};
+
+// 按cache_bytes选择分块:列数取整到缓存行,其余维度尽量接近等长,超出范围的维度截断后把预算让给其他维度
+// 默认用L1的一半,给输出或模板计算的邻居留出空间
+inline TileSize ChooseTileSize(uint32_t slices, uint32_t rows, uint32_t cols, size_t element_stride, size_t cache_bytes = TileSize::kL1CacheBytes / 2)
+{
+	element_stride = std::max<size_t>(element_stride, 1);
+	size_t budget = std::max<size_t>(cache_bytes / element_stride, 1);
+	uint32_t dimensions = (slices > 1 ? 1 : 0) + (rows > 1 ? 1 : 0) + 1;
+
+	TileSize tile;
+	size_t side = static_cast<size_t>(std::pow(static_cast<double>(budget), 1.0 / dimensions));
+
+	// 列方向至少一条缓存行,并按缓存行对齐
+	size_t line_elements = std::max<size_t>(TileSize::kCacheLineBytes / element_stride, 1);
+	size_t tile_cols = std::max(side, line_elements) / line_elements * line_elements;
+	tile.cols = static_cast<uint32_t>(std::clamp<size_t>(tile_cols, 1, std::max(cols, 1u)));
+	budget = std::max<size_t>(budget / tile.cols, 1);
+
+	if (slices > 1)
+	{
+		side = static_cast<size_t>(std::sqrt(static_cast<double>(budget)));
+		tile.rows = static_cast<uint32_t>(std::clamp<size_t>(side, 1, std::max(rows, 1u)));
+		budget = std::max<size_t>(budget / tile.rows, 1);
+		tile.slices = static_cast<uint32_t>(std::clamp<size_t>(budget, 1, slices));
+	}
+	else
+	{
+		tile.rows = static_cast<uint32_t>(std::clamp<size_t>(budget, 1, std::max(rows, 1u)));
+		tile.slices = 1;
+	}
+	return tile;
+}
+
+// 外层分块:按L2的一半选择,每个维度取整为内层分块的整数倍,一个外层分块由一个作业按顺序处理其中的内层分块
+inline TileSize ChooseBlockSize(uint32_t slices, uint32_t rows, uint32_t cols, size_t element_stride, const TileSize& tile)
+{
+	TileSize block = ChooseTileSize(slices, rows, cols, element_stride, TileSize::kL2CacheBytes / 2);
+	auto round_up = [](uint32_t size, uint32_t multiple)
+	{
+		return std::max((size + multiple - 1) / multiple, 1u) * multiple;
+	};
+
+	block.slices = round_up(block.slices, tile.slices);
+	block.rows = round_up(block.rows, tile.rows);
+	block.cols = round_up(block.cols, tile.cols);
+	return block;
+}
+
+// 二分点对齐到分块边界,叶子和分块网格重合
+inline uint32_t SplitAlignedToTile(uint32_t count, uint32_t tile)
+{
+	uint32_t tiles = (count + tile - 1) / tile;
+	return std::min(count, (tiles / 2) * tile);
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <functional>
+
+#include "job.hpp"
+
+// 弹性阻塞线程池,执行会阻塞在系统调用上的作业
+// 没有空闲线程时创建新线程(不超过上限),空闲超过kKeepAlive的线程自动退出
+// 线程对象由线程池持有:退出的线程下一次Push或Stop时被join,Stop返回后没有线程还在访问线程池
+class BlockingPool
+{
+public:
+	using Executor = std::function<void(Job*)>;
+
+	static constexpr uint32_t kDefaultMaxThreadCount = 256;
+	static constexpr std::chrono::seconds kKeepAlive{ 10 };
+
+	explicit BlockingPool(Executor executor, uint32_t max_thread_count = kDefaultMaxThreadCount)
+		: executor_(std::move(executor))
+		, max_thread_count_(max_thread_count)
+		, thread_count_(0)
+		, idle_thread_count_(0)
+		, stop_(false)
+	{
+	}
+
+	~BlockingPool()
+	{
+		Stop();
+	}
+
+	BlockingPool(const BlockingPool&) = delete;
+	BlockingPool& operator=(const BlockingPool&) = delete;
+
+	void Push(Job* job);
+
+	// 执行完已投递的作业后等待所有线程退出,之后仍可以继续投递
+	void Stop();
+
+	uint32_t GetThreadCount() const
+	{
+		std::unique_lock lock(mutex_);
+		return thread_count_;
+	}
+private:
+	void ThreadMain();
+
+	Executor executor_;
+	const uint32_t max_thread_count_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable condition_;
+	std::condition_variable exit_condition_;
+	std::deque<Job*> jobs_;
+	uint32_t thread_count_;
+	uint32_t idle_thread_count_;
+	bool stop_;
+	std::unordered_map<std::thread::id, std::thread> threads_;
+	// 已经离开循环、等待join的线程
+	std::vector<std::thread> exited_threads_;
+};
+
+inline void BlockingPool::Push(Job* job)
+{
+	std::vector<std::thread> exited_threads;
+	bool spawned = false;
+	{
+		std::unique_lock lock(mutex_);
+		jobs_.push_back(job);
+		exited_threads.swap(exited_threads_);
+
+		// 空闲线程不够时扩容,达到上限后作业排队
+		if (idle_thread_count_ < jobs_.size() && thread_count_ < max_thread_count_)
+		{
+			++thread_count_;
+			std::thread thread([this]()
+				{
+					ThreadMain();
+				});
+			threads_.emplace(thread.get_id(), std::move(thread));
+			spawned = true;
+		}
+	}
+
+	if (!spawned)
+	{
+		condition_.notify_one();
+	}
+
+	// 在锁外回收空闲超时退出的线程
+	for (auto& thread : exited_threads)
+	{
+		thread.join();
+	}
+}
+
+inline void BlockingPool::Stop()
+{
+	std::vector<std::thread> exited_threads;
+	{
+		std::unique_lock lock(mutex_);
+		stop_ = true;
+		condition_.notify_all();
+		exit_condition_.wait(lock, [this]()
+			{
+				return thread_count_ == 0;
+			});
+		stop_ = false;
+		exited_threads.swap(exited_threads_);
+	}
+
+	// 线程登记退出后还在释放锁和返回,join之后线程池才能被安全销毁
+	for (auto& thread : exited_threads)
+	{
+		thread.join();
+	}
+}
+
+inline void BlockingPool::ThreadMain()
+{
+	std::unique_lock lock(mutex_);
+	for (;;)
+	{
+		if (jobs_.empty())
+		{
+			++idle_thread_count_;
+			condition_.wait_for(lock, kKeepAlive, [this]()
+				{
+					return stop_ || !jobs_.empty();
+				});
+			--idle_thread_count_;
+
+			// 空闲超时或者线程池停止
+			if (jobs_.empty())
+			{
+				break;
+			}
+		}
+
+		Job* job = jobs_.front();
+		jobs_.pop_front();
+
+		lock.unlock();
+		executor_(job);
+		lock.lock();
+	}
+
+	--thread_count_;
+	auto thread = threads_.find(std::this_thread::get_id());
+	exited_threads_.push_back(std::move(thread->second));
+	threads_.erase(thread);
+	exit_condition_.notify_all();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+// 协作式取消令牌
+// 挂在根作业上,通过CreateJobAsChild被子作业继承;已取消的作业在出队执行时直接跳过,但仍然正常结算计数.
+// 可以指定父令牌,父令牌取消时子令牌也视为已取消.
+// 开启cancel_on_exception后,作业树中任意作业抛出异常都会取消整棵树
+class CancellationToken
+{
+public:
+	explicit CancellationToken(const CancellationToken* parent = nullptr, bool cancel_on_exception = false)
+		: parent_(parent)
+		, cancelled_(false)
+		, cancel_on_exception_(cancel_on_exception)
+	{
+	}
+
+	CancellationToken(const CancellationToken&) = delete;
+	CancellationToken& operator=(const CancellationToken&) = delete;
+
+	void Cancel() { cancelled_.store(true, std::memory_order_release); }
+
+	void Reset() { cancelled_.store(false, std::memory_order_relaxed); }
+
+	bool IsCancelOnException() const { return cancel_on_exception_; }
+	void SetCancelOnException(bool cancel_on_exception) { cancel_on_exception_ = cancel_on_exception; }
+
+	bool IsCancelled() const
+	{
+		for (const CancellationToken* token = this; token; token = token->parent_)
+		{
+			if (token->cancelled_.load(std::memory_order_acquire))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	const CancellationToken* parent_;
+	std::atomic_bool cancelled_;
+	bool cancel_on_exception_;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "job_system.hpp"
+#include "mpmc_queue.hpp"
+
+// 挂起在通道上的作业,被唤醒时把resume投递为新作业
+// Select会把同一个等待者挂到多个通道上,fired保证只被唤醒一次
+struct ChannelWaiter
+{
+	std::atomic_bool fired{ false };
+	std::function<void()> resume;
+};
+
+class ChannelWaitList
+{
+public:
+	ChannelWaitList()
+		: count_(0)
+		, purge_threshold_(kMinPurgeThreshold)
+	{
+	}
+
+	void Park(const std::shared_ptr<ChannelWaiter>& waiter)
+	{
+		std::unique_lock lock(mutex_);
+
+		// Select留下的已唤醒等待者在这里顺带清理,避免安静的通道上无限堆积
+		if (waiters_.size() >= purge_threshold_)
+		{
+			waiters_.erase(std::remove_if(waiters_.begin(), waiters_.end(), [](const std::shared_ptr<ChannelWaiter>& w)
+				{
+					return w->fired.load(std::memory_order_relaxed);
+				}), waiters_.end());
+			purge_threshold_ = std::max(kMinPurgeThreshold, waiters_.size() * 2);
+		}
+
+		waiters_.push_back(waiter);
+		count_.store(static_cast<uint32_t>(waiters_.size()), std::memory_order_seq_cst);
+	}
+
+	// 唤醒一个尚未被唤醒的等待者
+	void WakeOne(const JobSystem& job_system)
+	{
+		std::shared_ptr<ChannelWaiter> waiter;
+		{
+			std::unique_lock lock(mutex_);
+			while (!waiters_.empty())
+			{
+				std::shared_ptr<ChannelWaiter> front = std::move(waiters_.front());
+				waiters_.pop_front();
+				if (!front->fired.exchange(true, std::memory_order_acq_rel))
+				{
+					waiter = std::move(front);
+					break;
+				}
+			}
+			count_.store(static_cast<uint32_t>(waiters_.size()), std::memory_order_relaxed);
+		}
+
+		if (waiter)
+		{
+			job_system.Run(job_system.CreateJob([waiter](Job*)
+				{
+					waiter->resume();
+				}));
+		}
+	}
+
+	bool HasWaiters() const { return count_.load(std::memory_order_seq_cst) != 0; }
+private:
+	static constexpr size_t kMinPurgeThreshold = 16;
+
+	std::mutex mutex_;
+	std::deque<std::shared_ptr<ChannelWaiter>> waiters_;
+	std::atomic_uint32_t count_;
+	size_t purge_threshold_;
+};
+
+// Select中的一个分支,由Channel::OnReceive创建
+struct SelectCase
+{
+	// 尝试接收,成功时投递回调并返回true
+	std::function<bool()> try_receive;
+	// 挂起等待者,挂起后如果通道已有数据则唤醒一个等待者,防止丢失唤醒
+	std::function<void(const std::shared_ptr<ChannelWaiter>&)> park;
+	// 通道仍有数据且有等待者时唤醒一个
+	std::function<void()> signal;
+};
+
+// 有界通道,底层是无锁环形队列,容量必须是2的幂
+// Send/Receive不会阻塞工作线程:通道满或空时把后续处理挂起为等待者,有空位或数据时再作为新作业投递
+template<class T>
+class Channel
+{
+public:
+	explicit Channel(size_t capacity, JobSystem& job_system = JobSystem::Get())
+		: job_system_(job_system)
+		, queue_(capacity)
+	{
+	}
+
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	size_t GetCapacity() const { return queue_.GetCapacity(); }
+
+	// 失败时value保持不变
+	bool TrySend(T& value)
+	{
+		if (!queue_.Push(std::move(value)))
+		{
+			return false;
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (receivers_.HasWaiters())
+		{
+			receivers_.WakeOne(job_system_);
+		}
+		return true;
+	}
+
+	bool TryReceive(T& value)
+	{
+		if (!queue_.Pop(value))
+		{
+			return false;
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (senders_.HasWaiters())
+		{
+			senders_.WakeOne(job_system_);
+		}
+		return true;
+	}
+
+	// 发送成功后投递on_sent作为后续作业(可以为空)
+	void Send(T value, std::function<void()> on_sent = nullptr)
+	{
+		if (TrySend(value))
+		{
+			Continue(std::move(on_sent));
+			return;
+		}
+
+		auto holder = std::make_shared<T>(std::move(value));
+		auto waiter = std::make_shared<ChannelWaiter>();
+		waiter->resume = [this, holder, on_sent]()
+		{
+			Send(std::move(*holder), on_sent);
+		};
+
+		senders_.Park(waiter);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!queue_.IsFull())
+		{
+			senders_.WakeOne(job_system_);
+		}
+	}
+
+	// 收到数据后投递on_received作为后续作业
+	void Receive(std::function<void(T)> on_received);
+
+	// 作为Select的一个分支接收数据
+	SelectCase OnReceive(std::function<void(T)> on_received)
+	{
+		auto callback = std::make_shared<std::function<void(T)>>(std::move(on_received));
+
+		SelectCase select_case;
+		select_case.try_receive = [this, callback]()
+		{
+			auto value = std::make_shared<T>();
+			if (!TryReceive(*value))
+			{
+				return false;
+			}
+
+			job_system_.Run(job_system_.CreateJob([callback, value](Job*)
+				{
+					(*callback)(std::move(*value));
+				}));
+			return true;
+		};
+		select_case.park = [this](const std::shared_ptr<ChannelWaiter>& waiter)
+		{
+			receivers_.Park(waiter);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!queue_.IsEmpty())
+			{
+				receivers_.WakeOne(job_system_);
+			}
+		};
+		select_case.signal = [this]()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!queue_.IsEmpty() && receivers_.HasWaiters())
+			{
+				receivers_.WakeOne(job_system_);
+			}
+		};
+		return select_case;
+	}
+private:
+	void Continue(std::function<void()> continuation)
+	{
+		if (continuation)
+		{
+			job_system_.Run(job_system_.CreateJob([continuation](Job*)
+				{
+					continuation();
+				}));
+		}
+	}
+
+	JobSystem& job_system_;
+	MpmcQueue<T> queue_;
+	ChannelWaitList receivers_;
+	ChannelWaitList senders_;
+};
+
+// Select的实现,resumed表示是被某个通道唤醒后的重试
+// 唤醒消耗了那个通道唯一的一次唤醒,但重试按顺序尝试,可能从另一个通道取走数据;
+// 这时唤醒方的数据还在队列里,它的其他等待者却没有被唤醒.所以重试成功后给其余仍有数据的通道补发一次唤醒
+inline void SelectFrom(std::vector<SelectCase> cases, bool resumed)
+{
+	for (size_t i = 0; i < cases.size(); ++i)
+	{
+		if (cases[i].try_receive())
+		{
+			if (resumed)
+			{
+				for (size_t j = 0; j < cases.size(); ++j)
+				{
+					if (j != i)
+					{
+						cases[j].signal();
+					}
+				}
+			}
+			return;
+		}
+	}
+
+	auto waiter = std::make_shared<ChannelWaiter>();
+	waiter->resume = [cases]()
+	{
+		SelectFrom(cases, true);
+	};
+
+	for (auto& select_case : cases)
+	{
+		select_case.park(waiter);
+	}
+}
+
+// 等待多个通道中任意一个有数据,只有一个分支的回调会被投递
+// 所有通道都为空时,同一个等待者挂到每个通道上,被任一通道唤醒后重新尝试
+inline void Select(std::vector<SelectCase> cases)
+{
+	SelectFrom(std::move(cases), false);
+}
+
+template<class T>
+void Channel<T>::Receive(std::function<void(T)> on_received)
+{
+	Select({ OnReceive(std::move(on_received)) });
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+// 宽扇入计数器(SNZI风格的合并计数)
+// 子作业在创建线程对应的槽位上登记/结算,只有槽位0->1和1->0的跳变才会修改父作业的unfinished_jobs,
+// 从而避免成千上万个子作业争抢父作业同一条缓存行
+class FanInCounter
+{
+public:
+	static constexpr size_t kCacheLineSize = 64;
+
+	explicit FanInCounter(uint32_t slot_count)
+		: slot_count_(slot_count)
+		, slots_(new Slot[slot_count])
+	{
+		assert(slot_count >= 1);
+	}
+
+	FanInCounter(const FanInCounter&) = delete;
+	FanInCounter& operator=(const FanInCounter&) = delete;
+
+	uint32_t GetSlotCount() const { return slot_count_; }
+
+	std::atomic_int32_t* GetSlot(uint32_t index) const { return &slots_[index % slot_count_].count; }
+
+	// 所有槽位都已结算,计数器可以挂到新的父作业上
+	bool IsIdle() const
+	{
+		for (uint32_t i = 0; i < slot_count_; ++i)
+		{
+			if (slots_[i].count.load(std::memory_order_acquire) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 返回true表示槽位从0变为1,需要向父作业登记一次
+	static bool Arrive(std::atomic_int32_t* slot)
+	{
+		return slot->fetch_add(1, std::memory_order_relaxed) == 0;
+	}
+
+	// 返回true表示槽位归零,需要向父作业结算一次
+	static bool Depart(std::atomic_int32_t* slot)
+	{
+		return slot->fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+private:
+	struct alignas(kCacheLineSize) Slot
+	{
+		mutable std::atomic_int32_t count{ 0 };
+	};
+
+	uint32_t slot_count_;
+	std::unique_ptr<Slot[]> slots_;
+};
\ No newline at end of file
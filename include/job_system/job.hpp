@@ -1,18 +1,48 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <atomic>
+#include <exception>
+
+class FanInCounter;
+class JobCounter;
+class CancellationToken;
+
+// 作业的投递来源,用于区分排队延迟
+enum class JobSource : uint8_t
+{
+	kWorker,	// 工作线程Run,进入本地队列
+	kExternal,	// 非工作线程Run,进入注入队列
+	kAffinity,	// RunOn,进入指定工作线程的收件箱
+	kBlocking,	// RunBlocking,进入阻塞线程池
+	kCount,
+};
 
 struct Job;
 using JobFunction = std::function<void(Job*)>;
 
 struct Job
 {
+	static constexpr int32_t kMaxContinuationCount = 6;
+
 	JobFunction function;
 	Job* parent;
 	std::atomic_int32_t unfinished_jobs;
 	std::atomic_int32_t continuation_count;
-	Job* continuations[6];
+	Job* continuations[kMaxContinuationCount];
+	FanInCounter* fan_in;
+	std::atomic_int32_t* fan_in_slot;
+	JobCounter* counter;
+	CancellationToken* cancellation;
+	// Wait重新抛出异常时清除,同一个作业不会被重复抛出
+	mutable std::atomic_bool has_exception;
+	JobSource source;
+	// JobCategoryRegistry中的类别索引,0表示未命名
+	uint32_t category;
+	// 开启延迟统计时Run写入的入队时间(纳秒),0表示没有打点
+	uint64_t enqueue_time;
+	std::exception_ptr exception;
 };
 
 constexpr int s = sizeof(Job);
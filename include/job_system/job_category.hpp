@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#include "perf_counters.hpp"
+
+// 作业类别的注册表,类别按名字去重,索引从1开始,0表示未命名
+class JobCategoryRegistry
+{
+public:
+	static constexpr uint32_t kMaxCategoryCount = 1024;
+	static constexpr uint32_t kUnnamed = 0;
+
+	static JobCategoryRegistry& Get()
+	{
+		static JobCategoryRegistry registry;
+		return registry;
+	}
+
+	JobCategoryRegistry(const JobCategoryRegistry&) = delete;
+	JobCategoryRegistry& operator=(const JobCategoryRegistry&) = delete;
+
+	// 同名的类别返回同一个索引;超过kMaxCategoryCount时归入未命名
+	uint32_t Register(const std::string& name);
+
+	// 按字符串地址缓存在线程本地,同一个字面量只在每个线程第一次查找时加锁.
+	// 缓存同时保存内容,同一地址换成其他内容(例如复用的std::string::c_str()或栈上的数组)时重新查找
+	uint32_t Find(const char* name)
+	{
+		struct Entry
+		{
+			std::string name;
+			uint32_t id;
+		};
+
+		thread_local std::unordered_map<const char*, Entry> cache;
+		auto iter = cache.find(name);
+		if (iter != cache.end() && iter->second.name == name)
+		{
+			return iter->second.id;
+		}
+
+		uint32_t id = Register(name);
+		cache[name] = Entry{ name, id };
+		return id;
+	}
+
+	std::string GetName(uint32_t id) const
+	{
+		std::unique_lock lock(mutex_);
+		return id < names_.size() ? names_[id] : std::string();
+	}
+
+	uint32_t GetCount() const
+	{
+		std::unique_lock lock(mutex_);
+		return static_cast<uint32_t>(names_.size());
+	}
+private:
+	JobCategoryRegistry()
+		: names_{ "(unnamed)" }
+	{
+	}
+
+	mutable std::mutex mutex_;
+	std::vector<std::string> names_;
+};
+
+inline uint32_t JobCategoryRegistry::Register(const std::string& name)
+{
+	std::unique_lock lock(mutex_);
+	auto iter = std::find(names_.begin(), names_.end(), name);
+	if (iter != names_.end())
+	{
+		return static_cast<uint32_t>(iter - names_.begin());
+	}
+
+	assert(names_.size() < kMaxCategoryCount);
+	if (names_.size() >= kMaxCategoryCount)
+	{
+		return kUnnamed;
+	}
+
+	names_.push_back(name);
+	return static_cast<uint32_t>(names_.size() - 1);
+}
+
+// 作业类别,一般定义成静态变量,热路径上比按名字创建作业少一次查表
+class JobCategory
+{
+public:
+	explicit JobCategory(const std::string& name)
+		: id_(JobCategoryRegistry::Get().Register(name))
+	{
+	}
+
+	uint32_t GetId() const { return id_; }
+	std::string GetName() const { return JobCategoryRegistry::Get().GetName(id_); }
+private:
+	uint32_t id_;
+};
+
+// 一个类别的执行统计快照
+// 时间都是独占时间:作业内部Wait时顺带执行的其他作业,时间记到那些作业的类别上
+struct JobCategoryStats
+{
+	uint32_t id = 0;
+	std::string name;
+	uint64_t count = 0;
+	uint64_t total_ns = 0;
+	uint64_t max_ns = 0;
+	uint64_t cpu_ns = 0;
+	// 开启硬件计数器后才有值;hardware_count是成功读到计数器的执行次数,计算每次的平均值时用它做分母
+	uint64_t hardware_count = 0;
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t cache_misses = 0;
+	uint64_t branch_misses = 0;
+
+	JobCategoryStats& operator+=(const JobCategoryStats& other)
+	{
+		count += other.count;
+		total_ns += other.total_ns;
+		max_ns = std::max(max_ns, other.max_ns);
+		cpu_ns += other.cpu_ns;
+		hardware_count += other.hardware_count;
+		cycles += other.cycles;
+		instructions += other.instructions;
+		cache_misses += other.cache_misses;
+		branch_misses += other.branch_misses;
+		return *this;
+	}
+};
+
+// 一个线程上一个类别的计数器,写入规则同WorkerStatsCounters
+struct JobCategoryCounters
+{
+	enum Counter
+	{
+		kCount,
+		kTotalNs,
+		kMaxNs,
+		kCpuNs,
+		kHardwareCount,
+		kCycles,
+		kInstructions,
+		kCacheMisses,
+		kBranchMisses,
+		kCounterCount,
+	};
+
+	std::atomic_uint64_t values[kCounterCount] = {};
+
+	void Add(Counter counter, uint64_t value, bool shared)
+	{
+		if (shared)
+		{
+			values[counter].fetch_add(value, std::memory_order_relaxed);
+		}
+		else
+		{
+			values[counter].store(values[counter].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+	}
+
+	void Max(Counter counter, uint64_t value, bool shared)
+	{
+		uint64_t current = values[counter].load(std::memory_order_relaxed);
+		if (shared)
+		{
+			while (current < value && !values[counter].compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+		}
+		else if (current < value)
+		{
+			values[counter].store(value, std::memory_order_relaxed);
+		}
+	}
+
+	void Reset()
+	{
+		for (auto& value : values)
+		{
+			value.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void AddTo(JobCategoryStats& stats) const
+	{
+		stats.count += values[kCount].load(std::memory_order_relaxed);
+		stats.total_ns += values[kTotalNs].load(std::memory_order_relaxed);
+		stats.max_ns = std::max(stats.max_ns, values[kMaxNs].load(std::memory_order_relaxed));
+		stats.cpu_ns += values[kCpuNs].load(std::memory_order_relaxed);
+		stats.hardware_count += values[kHardwareCount].load(std::memory_order_relaxed);
+		stats.cycles += values[kCycles].load(std::memory_order_relaxed);
+		stats.instructions += values[kInstructions].load(std::memory_order_relaxed);
+		stats.cache_misses += values[kCacheMisses].load(std::memory_order_relaxed);
+		stats.branch_misses += values[kBranchMisses].load(std::memory_order_relaxed);
+	}
+};
+
+// 计时用的一组读数,硬件计数器的顺序同PerfCounterGroup::Counter
+struct JobCategorySample
+{
+	uint64_t wall_ns = 0;
+	uint64_t cpu_ns = 0;
+	PerfCounterGroup::Values hardware;
+
+	// 逐项相减,不足时取0
+	JobCategorySample operator-(const JobCategorySample& other) const
+	{
+		auto minus = [](uint64_t a, uint64_t b) { return a > b ? a - b : 0; };
+
+		JobCategorySample result;
+		result.wall_ns = minus(wall_ns, other.wall_ns);
+		result.cpu_ns = minus(cpu_ns, other.cpu_ns);
+		for (uint32_t i = 0; i < PerfCounterGroup::kCounterCount; ++i)
+		{
+			result.hardware.values[i] = minus(hardware.values[i], other.hardware.values[i]);
+		}
+		return result;
+	}
+
+	JobCategorySample operator+(const JobCategorySample& other) const
+	{
+		JobCategorySample result;
+		result.wall_ns = wall_ns + other.wall_ns;
+		result.cpu_ns = cpu_ns + other.cpu_ns;
+		for (uint32_t i = 0; i < PerfCounterGroup::kCounterCount; ++i)
+		{
+			result.hardware.values[i] = hardware.values[i] + other.hardware.values[i];
+		}
+		return result;
+	}
+};
+
+// 当前线程消耗的CPU时间(纳秒)
+inline uint64_t ReadThreadCpuTimeNs()
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+	{
+		return 0;
+	}
+
+	// FILETIME以100纳秒为单位
+	auto to_ns = [](const FILETIME& time)
+	{
+		return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+	};
+	return to_ns(kernel_time) + to_ns(user_time);
+#else
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+	{
+		return 0;
+	}
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <exception>
+
+struct Job;
+
+// 独立于Job的等待计数器
+// Run(job, counter)时加一,作业完成时减一;可以在计数器降到某个值时再投递作业,也可以等待计数器降到某个值.
+// 等待与作业生命周期解耦,作业完成后其槽位可以立即被作业池回收
+// 挂在计数器上的作业(含子作业)抛出异常时,计数器记录第一个异常,由下一次Wait(counter)重新抛出
+class JobCounter
+{
+public:
+	explicit JobCounter(int32_t value = 0)
+		: value_(value)
+		, waiter_count_(0)
+		, pending_decrements_(0)
+		, has_exception_(false)
+	{
+	}
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	int32_t GetValue() const { return value_.load(std::memory_order_acquire); }
+private:
+	friend class JobSystem;
+
+	std::atomic_int32_t value_;
+	std::atomic_int32_t waiter_count_;
+	// 正在执行减一的线程数,Wait返回前要等它们离开,计数器才能被安全销毁
+	std::atomic_int32_t pending_decrements_;
+	mutable std::mutex mutex_;
+	// 等待计数器降到first时投递的作业
+	std::vector<std::pair<int32_t, Job*>> waiters_;
+	// 异常由mutex_保护,has_exception_让没有异常时的Wait不用加锁;Wait取走异常时清除
+	mutable std::atomic_bool has_exception_;
+	mutable std::exception_ptr exception_;
+};
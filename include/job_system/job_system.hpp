@@ -6,17 +6,47 @@
 #include <random>
 #include <new>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
 
 #include "job.hpp"
 #include "work_stealing_queue.hpp"
+#include "fan_in_counter.hpp"
+#include "job_counter.hpp"
+#include "cancellation_token.hpp"
+#include "timer_wheel.hpp"
+#include "mpmc_queue.hpp"
+#include "blocking_pool.hpp"
+#include "trace.hpp"
+#include "scheduler_stats.hpp"
+#include "latency_histogram.hpp"
+#include "job_category.hpp"
+#include "work_span_analyzer.hpp"
+#include "partitioner.hpp"
+#include "blocked_range.hpp"
 
 class JobSystem
 {
+	friend class BlockingRegion;
 public:
 	static constexpr uint32_t kMaxJobCount = 32768;
 	static_assert((kMaxJobCount& (kMaxJobCount - 1)) == 0, "!");
+	static constexpr uint32_t kInvalidWorkerIndex = UINT32_MAX;
+	static constexpr uint32_t kMaxInboxJobCount = 1024;
+	// 阻塞区域最多同时补偿的工作线程数量
+	static constexpr uint32_t kMaxCompensatingWorkerCount = 16;
+	// ParallelFor2D/3D每个工作线程至少分到的外层分块数,不够时按内层分块创建作业
+	static constexpr uint32_t kBlocksPerWorker = 4;
 
-	using WorkStealingQueue = WorkStealingQueue<Job*,kMaxJobCount>;
+	using WorkStealingQueue = ::WorkStealingQueue<Job*,kMaxJobCount>;
+
+	// 空闲回调,返回true表示做了有效工作(例如投递了新作业)
+	using IdleHandler = std::function<bool()>;
 
 	JobSystem(const JobSystem&) = delete;
 	JobSystem(JobSystem&&) = delete;
@@ -28,68 +58,486 @@ public:
 	void Start(uint32_t worker_count);
 	void Stop();
 	void Run(Job* job) const;
+	// 等待作业完成,作业树中有作业抛出异常时重新抛出第一个异常
 	void Wait(const Job* job) const;
 
+	// 投递作业,计数器先加一,作业(含所有子作业)完成时减一
+	void Run(Job* job, JobCounter* counter) const;
+	// 计数器降到value(含)以下时才投递作业
+	void RunWhen(JobCounter* counter, int32_t value, Job* job) const;
+	// 优先交给指定工作线程执行(亲和性),该线程空闲前其他线程也可以窃取
+	void RunOn(uint32_t worker_index, Job* job) const;
+	// 等待计数器降到value(含)以下,同时执行其他作业;计数器上的作业抛出过异常时重新抛出第一个异常
+	void Wait(const JobCounter* counter, int32_t value = 0) const;
+
+	// 交给弹性阻塞线程池执行,适用于会阻塞在系统调用上的作业;完成后父作业和后续作业回到工作线程上执行
+	void RunBlocking(Job* job) const;
+
+	// 延迟delay之后投递作业
+	void RunAfter(TimerWheel::Clock::duration delay, Job* job) const;
+	// 每隔period用function创建一个新作业投递,直到token被取消
+	void RunEvery(TimerWheel::Clock::duration period, const JobFunction& function, CancellationToken* token = nullptr) const;
+
 	Job* CreateJob(const JobFunction& function) const;
 	Job* CreateJob(JobFunction&& function) const;
+	// 带类别的作业;按名字创建时按地址缓存查表结果,字面量等静态字符串在每个线程只查一次表,地址被复用于其他内容时重新查表
+	Job* CreateJob(const char* name, JobFunction function) const;
+	Job* CreateJob(const JobCategory& category, JobFunction function) const;
 	Job* CreateJobAsChild(Job* parent, const JobFunction& function) const;
 	Job* CreateJobAsChild(Job* parent, JobFunction&& function) const;
 
+	// 在调用方提供的存储上初始化作业,不经过作业池,适用于生命周期超出作业池回收周期的作业
+	Job* InitializeJob(Job* job, const JobFunction& function) const;
+	Job* InitializeJob(Job* job, JobFunction&& function) const;
+	Job* InitializeJobAsChild(Job* parent, Job* job, const JobFunction& function) const;
+	Job* InitializeJobAsChild(Job* parent, Job* job, JobFunction&& function) const;
+
 	void AddContinuation(Job* ancestor, Job* continuation) const;
 
+	// 为宽扇入的父作业挂接分槽计数器,必须在创建任何子作业之前调用
+	void SetFanInCounter(Job* job, FanInCounter* counter) const;
+
+	// 为作业挂接取消令牌,之后创建的子作业会继承该令牌
+	void SetCancellationToken(Job* job, CancellationToken* token) const;
+
+	// 子作业默认继承父作业的类别
+	void SetJobCategory(Job* job, const JobCategory& category) const { job->category = category.GetId(); }
+	bool IsCancelled(const Job* job) const;
+
+	// 当前线程正在执行的作业,不在作业中时返回nullptr
+	Job* GetCurrentJob() const { return CurrentJob(); }
+
+	// 注册空闲回调,工作线程找不到作业时调用(例如轮询io_context).回调中不能注销回调
+	uint32_t AddIdleHandler(IdleHandler handler);
+	void RemoveIdleHandler(uint32_t id);
+
+	// 各工作线程调度统计的快照,读取时才汇总,读取期间的计数可能不完全一致
+	SchedulerStats GetStats() const;
+	void ResetStats() const;
+
+	// 开启后Run给作业打上入队时间,Execute开始时把排队延迟记入执行线程的直方图;关闭时只多一次判断
+	void EnableLatencyTracking(bool enable) const { latency_tracking_.store(enable, std::memory_order_relaxed); }
+	bool IsLatencyTrackingEnabled() const { return latency_tracking_.load(std::memory_order_relaxed); }
+	// 排队延迟直方图的快照,可以在运行中读取
+	LatencyStats GetLatencyStats() const;
+	void ResetLatencyStats() const;
+
+	// 开启后按作业类别统计次数,独占执行时间和线程CPU时间;每个作业多两次读时钟和两次读线程CPU时间
+	// 类别计数器在第一次开启时才分配
+	void EnableCategoryAccounting(bool enable) const;
+	bool IsCategoryAccountingEnabled() const { return category_accounting_.load(std::memory_order_relaxed); }
+	// 类别统计同时读取硬件性能计数器(周期,指令,缓存未命中,分支预测失败),每个作业多两次read系统调用;
+	// 需要同时开启类别统计.调用线程打不开perf事件时返回false,仍然只统计时间
+	bool EnableHardwareCounters(bool enable) const;
+
+	// 挂接work/span分析器,之后创建和执行的作业都会被记录;传nullptr取消挂接.分析器必须比挂接期间执行的作业活得久
+	void SetWorkSpanAnalyzer(WorkSpanAnalyzer* analyzer) const { work_span_analyzer_.store(analyzer, std::memory_order_release); }
+	// 按类别索引排列,只包含执行过的类别
+	std::vector<JobCategoryStats> GetCategoryStats() const;
+	void ResetCategoryStats() const;
+
+	uint32_t GetWorkerCount() const { return worker_count_; }
+	// 当前线程的工作线程索引,非工作线程返回kInvalidWorkerIndex
+	uint32_t GetWorkerIndex() const { return WorkerIndex(); }
+
+	// splitter可以是整数(等同FixedPartitioner),也可以是FixedPartitioner,StaticPartitioner,AutoPartitioner,AffinityPartitioner或HeartbeatPartitioner
 	template<class T,class S>
 	Job* ParallelFor(T* data,uint32_t count,const std::function<void(T*,uint32_t)>& function,const S& splitter)
 	{
-		return CreateJob(std::bind(&JobSystem::ParallelForJob<T,S>,this,std::placeholders::_1,data,count,function,splitter));
+		if constexpr (std::is_integral_v<S>)
+		{
+			return ParallelFor(data, count, function, FixedPartitioner(static_cast<uint32_t>(splitter)));
+		}
+		else
+		{
+			auto partitioner = splitter.Begin(count, GetWorkerCount());
+			using P = decltype(partitioner);
+			return CreateJob(std::bind(&JobSystem::ParallelForJob<T, P>, this, std::placeholders::_1, data, 0u, count, function, partitioner));
+		}
+	}
+
+	// 二维范围的并行循环,两级分块:沿外层分块数最多的维度递归二分到一个外层分块(按L2选择)为一个作业,
+	// 作业内按顺序处理其中的内层分块(按L1选择),function每次处理一个内层分块
+	// row_pitch和element_stride以字节为单位;tile指定内层分块,为0的维度按缓存大小自动选择
+	template<class T>
+	Job* ParallelFor2D(T* data, uint32_t rows, uint32_t cols, size_t row_pitch, const std::function<void(const Tile2D<T>&)>& function,
+		TileSize tile = TileSize(), size_t element_stride = sizeof(T))
+	{
+		std::function<void(const Tile3D<T>&)> tile_function = [function](const Tile3D<T>& range)
+		{
+			function(Tile2D<T>{ range.data, range.row_begin, range.col_begin, range.rows, range.cols, range.row_pitch, range.element_stride });
+		};
+		return ParallelFor3D(data, 1, rows, cols, 0, row_pitch, tile_function, TileSize{ 1, tile.rows, tile.cols }, element_stride);
+	}
+
+	template<class T>
+	Job* ParallelFor3D(T* data, uint32_t slices, uint32_t rows, uint32_t cols, size_t slice_pitch, size_t row_pitch,
+		const std::function<void(const Tile3D<T>&)>& function, TileSize tile = TileSize(), size_t element_stride = sizeof(T))
+	{
+		TileSize chosen = ChooseTileSize(slices, rows, cols, element_stride);
+		tile.slices = std::max(tile.slices ? tile.slices : chosen.slices, 1u);
+		tile.rows = std::max(tile.rows ? tile.rows : chosen.rows, 1u);
+		tile.cols = std::max(tile.cols ? tile.cols : chosen.cols, 1u);
+
+		// 外层分块不够每个工作线程分到几个时,退回按内层分块创建作业
+		TileSize block = ChooseBlockSize(slices, rows, cols, element_stride, tile);
+		uint64_t block_count = uint64_t((slices + block.slices - 1) / block.slices) * ((rows + block.rows - 1) / block.rows) * ((cols + block.cols - 1) / block.cols);
+		if (block_count < uint64_t(GetWorkerCount()) * kBlocksPerWorker)
+		{
+			block = tile;
+		}
+
+		Tile3D<T> range{ data, 0, 0, 0, slices, rows, cols, slice_pitch, row_pitch, element_stride };
+		return CreateJob(std::bind(&JobSystem::ParallelForTileJob<T>, this, std::placeholders::_1, range, tile, block, function));
 	}
 private:
 	JobSystem();
 
-	template<class T,class S>
-	void ParallelForJob(Job* job,T* data,uint32_t count,const std::function<void(T*, uint32_t)>& function,const S& splitter)
+	template<class T>
+	void ParallelForTileJob(Job* job, const Tile3D<T>& range, const TileSize& tile, const TileSize& block, const std::function<void(const Tile3D<T>&)>& function)
+	{
+		if (range.slices == 0 || range.rows == 0 || range.cols == 0)
+		{
+			return;
+		}
+
+		// 分块数相同时优先切外层维度,保持行内连续
+		uint32_t slice_blocks = (range.slices + block.slices - 1) / block.slices;
+		uint32_t row_blocks = (range.rows + block.rows - 1) / block.rows;
+		uint32_t col_blocks = (range.cols + block.cols - 1) / block.cols;
+		if (slice_blocks <= 1 && row_blocks <= 1 && col_blocks <= 1)
+		{
+			ForEachTile(job, range, tile, function);
+			return;
+		}
+
+		Tile3D<T> left = range;
+		Tile3D<T> right = range;
+		if (slice_blocks >= row_blocks && slice_blocks >= col_blocks)
+		{
+			uint32_t mid = SplitAlignedToTile(range.slices, block.slices);
+			left.slices = mid;
+			right.slices -= mid;
+			right.slice_begin += mid;
+			right.data = reinterpret_cast<T*>(reinterpret_cast<char*>(range.data) + mid * range.slice_pitch);
+		}
+		else if (row_blocks >= col_blocks)
+		{
+			uint32_t mid = SplitAlignedToTile(range.rows, block.rows);
+			left.rows = mid;
+			right.rows -= mid;
+			right.row_begin += mid;
+			right.data = reinterpret_cast<T*>(reinterpret_cast<char*>(range.data) + mid * range.row_pitch);
+		}
+		else
+		{
+			uint32_t mid = SplitAlignedToTile(range.cols, block.cols);
+			left.cols = mid;
+			right.cols -= mid;
+			right.col_begin += mid;
+			right.data = reinterpret_cast<T*>(reinterpret_cast<char*>(range.data) + mid * range.element_stride);
+		}
+
+		Run(CreateJobAsChild(job, std::bind(&JobSystem::ParallelForTileJob<T>, this, std::placeholders::_1, left, tile, block, function)));
+		if (IsCancelled(job))
+		{
+			return;
+		}
+		Run(CreateJobAsChild(job, std::bind(&JobSystem::ParallelForTileJob<T>, this, std::placeholders::_1, right, tile, block, function)));
+	}
+
+	// 按行优先的顺序处理一个外层分块中的内层分块,外层分块是内层分块的整数倍,内层分块和全局分块网格重合
+	template<class T>
+	void ForEachTile(Job* job, const Tile3D<T>& range, const TileSize& tile, const std::function<void(const Tile3D<T>&)>& function)
 	{
-		if(count > splitter)
+		for (uint32_t slice = 0; slice < range.slices; slice += tile.slices)
+		{
+			for (uint32_t row = 0; row < range.rows; row += tile.rows)
+			{
+				for (uint32_t col = 0; col < range.cols; col += tile.cols)
+				{
+					Tile3D<T> sub = range;
+					sub.slice_begin += slice;
+					sub.row_begin += row;
+					sub.col_begin += col;
+					sub.slices = std::min(tile.slices, range.slices - slice);
+					sub.rows = std::min(tile.rows, range.rows - row);
+					sub.cols = std::min(tile.cols, range.cols - col);
+					sub.data = reinterpret_cast<T*>(reinterpret_cast<char*>(range.data)
+						+ slice * range.slice_pitch + row * range.row_pitch + col * range.element_stride);
+					function(sub);
+				}
+
+				if (IsCancelled(job))
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	// offset是data在整个范围中的下标,供分割器识别子范围
+	template<class T,class P>
+	void ParallelForJob(Job* job,T* data,uint32_t offset,uint32_t count,const std::function<void(T*, uint32_t)>& function,const P& partitioner)
+	{
+		uint32_t worker_index = WorkerIndex();
+		bool is_worker = worker_index != kInvalidWorkerIndex && worker_index < work_queues_.size();
+
+		// 原地分割的循环才响应窃取请求,只有在这期间其他线程扑空才会给本线程置位
+		StealDemand* demand = nullptr;
+		if constexpr (P::kSplitInPlace)
 		{
-			uint32_t left_count = count / 2;
-			Job* left = CreateJobAsChild(job, std::bind(&JobSystem::ParallelForJob<T, S>, this, std::placeholders::_1, data, left_count,function,splitter));
-			Run(left);
+			demand = is_worker ? &steal_demands_[worker_index] : nullptr;
+		}
+		StealDemandListener listener(demand);
+
+		while (count > 0)
+		{
+			PartitionContext context{ GetWorkerCount(), worker_index, is_worker ? static_cast<uint32_t>(GetWorkerThreadQueue()->GetSize()) : 0u,
+				demand ? &demand->value : nullptr };
+			if (count > 1 && partitioner.ShouldSplit(context, offset, count))
+			{
+				uint32_t left_count = count / 2;
+				if constexpr (P::kSplitInPlace)
+				{
+					// 只提升右半部分,左半部分继续在本作业中执行
+					Job* right = CreateJobAsChild(job, std::bind(&JobSystem::ParallelForJob<T, P>, this, std::placeholders::_1, data + left_count, offset + left_count, count - left_count, function, partitioner));
+					RunPartition(right, partitioner.GetAffinity(offset + left_count, count - left_count));
+					count = left_count;
+					continue;
+				}
+
+				Job* left = CreateJobAsChild(job, std::bind(&JobSystem::ParallelForJob<T, P>, this, std::placeholders::_1, data, offset, left_count, function, partitioner));
+				RunPartition(left, partitioner.GetAffinity(offset, left_count));
+
+				if (IsCancelled(job))
+				{
+					return;
+				}
+
+				uint32_t right_count = count - left_count;
+				Job* right = CreateJobAsChild(job, std::bind(&JobSystem::ParallelForJob<T, P>, this, std::placeholders::_1, data + left_count, offset + left_count, right_count, function, partitioner));
+				RunPartition(right, partitioner.GetAffinity(offset + left_count, right_count));
+				return;
+			}
+
+			// 不再二分时取一块顺序执行,剩余部分重新判断
+			uint32_t chunk = std::max(partitioner.GetChunkSize(count), 1u);
+			partitioner.Execute(context, offset, chunk, [&function, data, chunk]() { function(data, chunk); });
+			data += chunk;
+			offset += chunk;
+			count -= chunk;
+
+			if (IsCancelled(job))
+			{
+				return;
+			}
+		}
+	}
 
-			uint32_t right_count = count - left_count;
-			Job* right = CreateJobAsChild(job, std::bind(&JobSystem::ParallelForJob<T, S>, this, std::placeholders::_1, data + left_count, right_count,function,splitter));
-			Run(right);
+	// 分割出的子作业有亲和的工作线程时投递到它的收件箱,否则本地投递
+	void RunPartition(Job* job, uint32_t worker_index) const
+	{
+		if (worker_index != PartitionContext::kNoAffinity && worker_index != WorkerIndex())
+		{
+			RunOn(worker_index, job);
 		}
 		else
 		{
-			function(data, count);
+			Run(job);
 		}
 	}
 
+	void AttachChild(Job* parent, Job* job) const;
+
 	void Finish(Job* job) const;
 
+	void DecrementCounter(JobCounter* counter) const;
+	void SetCounterException(JobCounter* counter, const std::exception_ptr& exception) const;
+
+	void SetException(Job* job, const std::exception_ptr& exception) const;
+
 	uint32_t GenerateRandomNumber(uint32_t min, uint32_t max) const;
 
 	Job* GetJob() const;
 
+	Job* GetIdleJob() const;
+
+	bool OnTimerExpired(TimerWheel::Timer* timer) const;
+
+	bool RunIdleHandlers() const;
+
 	void Execute(Job* job) const;
 
 	bool HasJobCompleted(const Job* job) const noexcept;
 
+	// 当前线程的统计计数器,非工作线程共享最后一组
+	WorkerStatsCounters* GetStatsCounters() const;
+
+	void CountStat(WorkerStatsCounters::Counter counter, uint64_t value = 1) const;
+
+	void StampEnqueueTime(Job* job, JobSource source) const;
+
+	void RecordLatency(Job* job) const;
+
+	struct CategoryTiming
+	{
+		JobCategorySample begin;
+		JobCategorySample outer_nested;
+		// 没有开启或打不开硬件计数器时为nullptr
+		PerfCounterGroup* hardware;
+	};
+
+	void BeginCategoryTiming(CategoryTiming& timing) const;
+
+	void EndCategoryTiming(const Job* job, const CategoryTiming& timing) const;
+	void AllocateCategoryCounters() const;
+
+	// 当前线程上正在计时的作业里,嵌套执行的其他作业用掉的时间和硬件计数
+	static JobCategorySample& NestedCategorySample();
+
+	void BeginBlocking();
+
+	void EndBlocking();
+
+	void CompensatorMain(uint32_t slot, std::promise<void>* registered);
+
 	Job* AllocateJob() const;
+	void HelpWhileJobPoolExhausted() const;
 
 	WorkStealingQueue* GetWorkerThreadQueue() const;
 
+	static uint32_t& WorkerIndex();
+
+	static Job*& CurrentJob();
+
 	std::mutex mutex_;
 	std::atomic_bool start_;
 	std::atomic_uint32_t worker_count_;
 	std::vector<std::thread> workers_;
 	std::vector<WorkStealingQueue*> work_queues_;
+	// 每个工作线程的收件箱,保存通过RunOn指定给它的作业
+	std::vector<std::unique_ptr<MpmcQueue<Job*>>> worker_inboxes_;
 	mutable std::default_random_engine random_engine_;
+	mutable TimerWheel timer_wheel_;
+	// 非工作线程提交的作业
+	mutable MpmcQueue<Job*> injection_queue_;
+	mutable std::shared_mutex idle_mutex_;
+	std::atomic_uint32_t idle_handler_count_;
+	uint32_t next_idle_handler_id_;
+	std::vector<std::pair<uint32_t, IdleHandler>> idle_handlers_;
+	mutable BlockingPool blocking_pool_;
+	// 补偿工作线程,工作线程在阻塞区域内时顶替它执行作业,队列位于work_queues_末尾
+	std::mutex compensator_mutex_;
+	std::condition_variable compensator_condition_;
+	std::vector<std::thread> compensators_;
+	std::atomic_uint32_t compensator_slot_count_;
+	std::atomic_uint32_t wanted_compensator_count_;
+	std::atomic_uint32_t running_compensator_count_;
+	uint32_t parked_compensator_count_;
+	// 窃取扑空时给目标线程置位,心跳分割据此立即提升作业;每项独占一条缓存行
+	// 只有目标线程正在执行心跳循环(listener_count不为0)时才置位,其他时候的扑空不会留下过期的请求
+	struct alignas(64) StealDemand
+	{
+		std::atomic_bool value{ false };
+		// 只有所属线程修改,循环嵌套执行时大于1
+		std::atomic_uint32_t listener_count{ 0 };
+	};
+
+	// 作用域内本线程登记为窃取请求的接收方;最外层进入时清掉之前遗留的请求
+	class StealDemandListener
+	{
+	public:
+		explicit StealDemandListener(StealDemand* demand)
+			: demand_(demand)
+		{
+			if (demand_)
+			{
+				uint32_t listener_count = demand_->listener_count.load(std::memory_order_relaxed);
+				if (listener_count == 0)
+				{
+					demand_->value.store(false, std::memory_order_relaxed);
+				}
+				demand_->listener_count.store(listener_count + 1, std::memory_order_relaxed);
+			}
+		}
+
+		~StealDemandListener()
+		{
+			if (demand_)
+			{
+				demand_->listener_count.store(demand_->listener_count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+			}
+		}
+
+		StealDemandListener(const StealDemandListener&) = delete;
+		StealDemandListener& operator=(const StealDemandListener&) = delete;
+	private:
+		StealDemand* demand_;
+	};
+	std::unique_ptr<StealDemand[]> steal_demands_;
+	std::unique_ptr<WorkerStatsCounters[]> stats_counters_;
+	uint32_t stats_counter_count_;
+	// 每组统计计数器对应kCount个直方图,按[线程][来源]排列
+	std::unique_ptr<LatencyHistogram[]> latency_histograms_;
+	mutable std::atomic_bool latency_tracking_;
+	// 每组统计计数器对应kMaxCategoryCount个类别计数器,按[线程][类别]排列;
+	// 很大,第一次开启类别统计时才分配,之后在Start之前一直有效
+	mutable std::mutex category_counters_mutex_;
+	mutable std::unique_ptr<JobCategoryCounters[]> category_counter_storage_;
+	mutable std::atomic<JobCategoryCounters*> category_counters_;
+	mutable std::atomic_bool category_accounting_;
+	mutable std::atomic_bool hardware_counters_;
+	mutable std::atomic<WorkSpanAnalyzer*> work_span_analyzer_;
+};
+
+// 作用域内当前工作线程将要阻塞(等锁,sleep,同步IO),期间由一个补偿工作线程顶替它执行作业
+class BlockingRegion
+{
+public:
+	explicit BlockingRegion(JobSystem& job_system = JobSystem::Get())
+		: job_system_(job_system)
+		, active_(job_system.GetWorkerIndex() != JobSystem::kInvalidWorkerIndex && job_system.start_)
+	{
+		if (active_)
+		{
+			job_system_.BeginBlocking();
+		}
+	}
+
+	~BlockingRegion()
+	{
+		if (active_)
+		{
+			job_system_.EndBlocking();
+		}
+	}
+
+	BlockingRegion(const BlockingRegion&) = delete;
+	BlockingRegion& operator=(const BlockingRegion&) = delete;
+private:
+	JobSystem& job_system_;
+	const bool active_;
 };
 
 inline JobSystem::JobSystem()
 	: start_(false)
 	, worker_count_(0)
 	, random_engine_(static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count()))
+	, injection_queue_(kMaxJobCount)
+	, idle_handler_count_(0)
+	, next_idle_handler_id_(0)
+	, blocking_pool_([this](Job* job) { Execute(job); })
+	, compensator_slot_count_(0)
+	, wanted_compensator_count_(0)
+	, running_compensator_count_(0)
+	, parked_compensator_count_(0)
+	, stats_counter_count_(0)
+	, latency_tracking_(false)
+	, category_counters_(nullptr)
+	, category_accounting_(false)
+	, hardware_counters_(false)
+	, work_span_analyzer_(nullptr)
 {
 }
 
@@ -108,9 +556,29 @@ inline void JobSystem::Start(uint32_t worker_count)
 		start_ = true;
 		worker_count_ = 0;
 
-		work_queues_.resize(worker_count);
+		// 末尾预留补偿工作线程的队列
+		work_queues_.assign(worker_count + kMaxCompensatingWorkerCount, nullptr);
+		steal_demands_ = std::make_unique<StealDemand[]>(worker_count + kMaxCompensatingWorkerCount);
+
+		// 每个工作线程(含补偿工作线程)一组计数器,最后一组给非工作线程
+		stats_counter_count_ = worker_count + kMaxCompensatingWorkerCount + 1;
+		stats_counters_ = std::make_unique<WorkerStatsCounters[]>(stats_counter_count_);
+		latency_histograms_ = std::make_unique<LatencyHistogram[]>(stats_counter_count_ * static_cast<uint32_t>(JobSource::kCount));
+		category_counters_.store(nullptr, std::memory_order_relaxed);
+		category_counter_storage_.reset();
+		if (category_accounting_.load(std::memory_order_relaxed))
+		{
+			AllocateCategoryCounters();
+		}
+
+		worker_inboxes_.clear();
+		for (uint32_t i = 0; i < worker_count; ++i)
+		{
+			worker_inboxes_.push_back(std::make_unique<MpmcQueue<Job*>>(kMaxInboxJobCount));
+		}
 
-		// ¼̶߳
+		// 记录主线程队列
+		WorkerIndex() = worker_count_;
 		work_queues_[worker_count_] = GetWorkerThreadQueue();
 		++worker_count_;
 
@@ -118,13 +586,14 @@ inline void JobSystem::Start(uint32_t worker_count)
 		{
 			workers_.emplace_back([this, worker_count]()
 				{
-					// ¼̶߳
+					// 记录工作线程队列
 					{
 						std::unique_lock loc(mutex_);
+						WorkerIndex() = worker_count_;
 						work_queues_[worker_count_++] = GetWorkerThreadQueue();
 					}
 
-					//ȴ̳߳ʼ
+					//等待工作线程初始化完成
 					while (worker_count_ != worker_count) {};
 
 					while (start_)
@@ -135,16 +604,22 @@ inline void JobSystem::Start(uint32_t worker_count)
 							Execute(job);
 						}
 					}
+
+					// 退出前关闭可能还开着的空闲区间
+					JOB_SYSTEM_TRACE(kIdleEnd, nullptr, WorkerIndex());
 				});
 		}
 
-		//ȴ̳߳ʼ
+		//等待工作线程初始化完成
 		while (worker_count_ != worker_count) {}
 	}
 }
 
 inline void JobSystem::Stop()
 {
+	// 阻塞作业完成时还需要工作线程执行后续作业
+	blocking_pool_.Stop();
+
 	start_ = false;
 	for (auto& worker : workers_)
 	{
@@ -153,38 +628,100 @@ inline void JobSystem::Stop()
 			worker.join();
 		}
 	}
+	// 允许再次Start
+	workers_.clear();
+
+	{
+		std::unique_lock lock(compensator_mutex_);
+		compensator_condition_.notify_all();
+	}
+	for (auto& compensator : compensators_)
+	{
+		compensator.join();
+	}
+	compensators_.clear();
+	compensator_slot_count_ = 0;
+	wanted_compensator_count_ = 0;
 }
 
 inline Job* JobSystem::CreateJob(const JobFunction& function) const
 {
-	Job* job = AllocateJob();
-	if (job)
-	{
-		job->function = function;
-		job->parent = nullptr;
-		job->unfinished_jobs.store(1,std::memory_order_relaxed);
-		job->continuation_count.store(0, std::memory_order_relaxed);
+	return InitializeJob(AllocateJob(), function);
+}
 
-		return job;
+inline Job* JobSystem::InitializeJob(Job* job, const JobFunction& function) const
+{
+	assert(job);
+
+	job->function = function;
+	job->parent = nullptr;
+	job->unfinished_jobs.store(1, std::memory_order_relaxed);
+	job->continuation_count.store(0, std::memory_order_relaxed);
+	job->fan_in = nullptr;
+	job->fan_in_slot = nullptr;
+	job->counter = nullptr;
+	job->cancellation = nullptr;
+	job->has_exception.store(false, std::memory_order_relaxed);
+	job->category = JobCategoryRegistry::kUnnamed;
+	job->enqueue_time = 0;
+	job->exception = nullptr;
+
+	if (WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire))
+	{
+		analyzer->OnCreate(job);
 	}
 
-	return nullptr;
+	return job;
 }
 
 inline Job* JobSystem::CreateJob(JobFunction&& function) const
 {
-	Job* job = AllocateJob();
-	if (job)
+	return InitializeJob(AllocateJob(), std::move(function));
+}
+
+inline Job* JobSystem::InitializeJob(Job* job, JobFunction&& function) const
+{
+	assert(job);
+
+	job->function = std::move(function);
+	job->parent = nullptr;
+	job->unfinished_jobs.store(1, std::memory_order_relaxed);
+	job->continuation_count.store(0, std::memory_order_relaxed);
+	job->fan_in = nullptr;
+	job->fan_in_slot = nullptr;
+	job->counter = nullptr;
+	job->cancellation = nullptr;
+	job->has_exception.store(false, std::memory_order_relaxed);
+	job->category = JobCategoryRegistry::kUnnamed;
+	job->enqueue_time = 0;
+	job->exception = nullptr;
+
+	if (WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire))
 	{
-		job->function = std::move(function);
-		job->parent = nullptr;
-		job->unfinished_jobs.store(1, std::memory_order_relaxed);
-		job->continuation_count.store(0, std::memory_order_relaxed);
+		analyzer->OnCreate(job);
+	}
 
-		return job;
+	return job;
+}
+
+inline Job* JobSystem::CreateJob(const char* name, JobFunction function) const
+{
+	Job* job = CreateJob(std::move(function));
+	if (job)
+	{
+		job->category = JobCategoryRegistry::Get().Find(name);
 	}
+	return job;
+}
 
-	return nullptr;
+inline Job* JobSystem::CreateJob(const JobCategory& category, JobFunction function) const
+{
+	Job* job = CreateJob(std::move(function));
+	if (job)
+	{
+		job->category = category.GetId();
+	}
+	return job;
 }
 
 inline Job* JobSystem::CreateJobAsChild(Job* parent, const JobFunction& function) const
@@ -192,143 +729,1057 @@ inline Job* JobSystem::CreateJobAsChild(Job* parent, const JobFunction& function
 	assert(parent);
 
 	Job* job = CreateJob(function);
-	if (job)
-	{
-		parent->unfinished_jobs.fetch_add(1, std::memory_order_relaxed);
-		job->parent = parent;
-
-		return job;
-	}
+	AttachChild(parent, job);
 
-	return nullptr;
+	return job;
 }
 
 inline Job* JobSystem::CreateJobAsChild(Job* parent, JobFunction&& function) const
 {
 	assert(parent);
 
-	Job* job = CreateJob(function);
-	if (job)
-	{
-		parent->unfinished_jobs.fetch_add(1, std::memory_order_relaxed);
-		job->parent = parent;
+	Job* job = CreateJob(std::move(function));
+	AttachChild(parent, job);
 
-		return job;
-	}
+	return job;
+}
 
-	return nullptr;
+inline Job* JobSystem::InitializeJobAsChild(Job* parent, Job* job, const JobFunction& function) const
+{
+	assert(parent);
+
+	InitializeJob(job, function);
+	AttachChild(parent, job);
+
+	return job;
+}
+
+inline Job* JobSystem::InitializeJobAsChild(Job* parent, Job* job, JobFunction&& function) const
+{
+	assert(parent);
+
+	InitializeJob(job, std::move(function));
+	AttachChild(parent, job);
+
+	return job;
 }
 
 inline void JobSystem::AddContinuation(Job* ancestor, Job* continuation) const
 {
 	auto index = ancestor->continuation_count.fetch_add(1, std::memory_order_relaxed);
+	assert(index < Job::kMaxContinuationCount);
 	ancestor->continuations[index] = continuation;
+
+	if (WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire))
+	{
+		analyzer->OnContinuation(ancestor, continuation);
+	}
 }
 
-inline void JobSystem::Run(Job* job) const
+inline void JobSystem::SetFanInCounter(Job* job, FanInCounter* counter) const
 {
-	WorkStealingQueue* queue = GetWorkerThreadQueue();
-	queue->Push(job);
+	assert(job && counter && counter->IsIdle());
+
+	job->fan_in = counter;
 }
 
-inline void JobSystem::Wait(const Job* job) const
+inline void JobSystem::SetCancellationToken(Job* job, CancellationToken* token) const
 {
-	// ȴҵ,ͬʱκι
-	while (!HasJobCompleted(job))
-	{
-		Job* next_job = GetJob();
-		if (next_job)
-		{
-			Execute(next_job);
-		}
-	}
+	assert(job);
+
+	job->cancellation = token;
 }
 
-inline void JobSystem::Finish(Job* job) const
+inline bool JobSystem::IsCancelled(const Job* job) const
 {
 	assert(job);
 
-	int32_t unfinished_jobs = job->unfinished_jobs.fetch_sub(1, std::memory_order_relaxed);
-	if (--unfinished_jobs == 0)
+	return job->cancellation && job->cancellation->IsCancelled();
+}
+
+inline uint32_t JobSystem::AddIdleHandler(IdleHandler handler)
+{
+	std::unique_lock lock(idle_mutex_);
+	uint32_t id = next_idle_handler_id_++;
+	idle_handlers_.emplace_back(id, std::move(handler));
+	idle_handler_count_.store(static_cast<uint32_t>(idle_handlers_.size()), std::memory_order_release);
+	return id;
+}
+
+inline void JobSystem::RemoveIdleHandler(uint32_t id)
+{
+	// 独占锁会等待正在执行的回调返回,注销之后回调不会再被调用
+	std::unique_lock lock(idle_mutex_);
+	for (auto it = idle_handlers_.begin(); it != idle_handlers_.end(); ++it)
 	{
-		if (job->parent)
+		if (it->first == id)
 		{
-			Finish(job->parent);
+			idle_handlers_.erase(it);
+			break;
 		}
+	}
+	idle_handler_count_.store(static_cast<uint32_t>(idle_handlers_.size()), std::memory_order_release);
+}
+
+inline void JobSystem::Run(Job* job) const
+{
+	JOB_SYSTEM_TRACE(kEnqueue, job, WorkerIndex());
 
-		for (int32_t i = 0; i < job->continuation_count; ++i)
+	// 非工作线程的队列不会被窃取,作业放入注入队列由工作线程领取
+	if (WorkerIndex() == kInvalidWorkerIndex)
+	{
+		StampEnqueueTime(job, JobSource::kExternal);
+		while (!injection_queue_.Push(job))
 		{
-			Run(job->continuations[i]);
+			std::this_thread::yield();
 		}
+		CountStat(WorkerStatsCounters::kJobsPushed);
+		return;
 	}
+
+	StampEnqueueTime(job, JobSource::kWorker);
+	WorkStealingQueue* queue = GetWorkerThreadQueue();
+	queue->Push(job);
+
+	WorkerStatsCounters* counters = GetStatsCounters();
+	counters->Add(WorkerStatsCounters::kJobsPushed, 1, false);
+	counters->Max(WorkerStatsCounters::kMaxDequeDepth, queue->GetSize());
 }
 
-inline uint32_t JobSystem::GenerateRandomNumber(uint32_t min, uint32_t max) const
+inline void JobSystem::Run(Job* job, JobCounter* counter) const
 {
-	if(!work_queues_[0]->IsEmpty())
-	{
-		return 0;
-	}
+	assert(job && counter && job->counter == nullptr);
 
-	std::uniform_int_distribution<uint32_t> u(min, max - 1);
-	return u(random_engine_);
+	counter->value_.fetch_add(1, std::memory_order_relaxed);
+	job->counter = counter;
+	Run(job);
 }
 
-inline Job* JobSystem::GetJob() const
+inline void JobSystem::RunWhen(JobCounter* counter, int32_t value, Job* job) const
 {
-	WorkStealingQueue* queue = GetWorkerThreadQueue();
+	assert(counter && job);
 
-	Job* job = queue->Pop();
-	if (job == nullptr)
 	{
-		//ǰ̵߳ĹǿյģԴȡ
-		uint32_t random_index = GenerateRandomNumber(0, worker_count_);
-		WorkStealingQueue* steal_queue = work_queues_[random_index];
-		if (steal_queue == queue)
-		{
-			std::this_thread::yield();
-			return nullptr;
-		}
+		std::unique_lock lock(counter->mutex_);
 
-		Job* stolen_job = steal_queue->Steal();
-		if (stolen_job == nullptr)
+		// 先登记等待者再检查计数器,与DecrementCounter中的先减后查配对,避免丢失唤醒
+		counter->waiter_count_.fetch_add(1, std::memory_order_seq_cst);
+		if (counter->value_.load(std::memory_order_seq_cst) > value)
 		{
-
-			std::this_thread::yield();
-			return nullptr;
+			counter->waiters_.emplace_back(value, job);
+			return;
 		}
-
-		return stolen_job;
+		counter->waiter_count_.fetch_sub(1, std::memory_order_relaxed);
 	}
 
-	return job;
+	Run(job);
 }
 
-inline void JobSystem::Execute(Job* job) const
+inline void JobSystem::RunAfter(TimerWheel::Clock::duration delay, Job* job) const
 {
-	job->function(job);
-	job->function = nullptr;
-	Finish(job);
+	assert(job);
+
+	// Now()向下取整,当前tick已经过去了一部分,多等一个tick保证不会提前触发
+	auto timer = new TimerWheel::Timer();
+	timer->expire_tick = timer_wheel_.Now() + timer_wheel_.ToTicks(delay) + 1;
+	timer->period_ticks = 0;
+	timer->job = job;
+	timer->token = nullptr;
+	timer_wheel_.Add(timer);
 }
 
-inline bool JobSystem::HasJobCompleted(const Job* job) const noexcept
+inline void JobSystem::RunEvery(TimerWheel::Clock::duration period, const JobFunction& function, CancellationToken* token) const
 {
-	assert(job);
-
-	return job->unfinished_jobs.load(std::memory_order_relaxed) == 0;
+	auto timer = new TimerWheel::Timer();
+	timer->period_ticks = std::max<uint64_t>(timer_wheel_.ToTicks(period), 1);
+	timer->expire_tick = timer_wheel_.Now() + timer->period_ticks + 1;
+	timer->job = nullptr;
+	timer->function = function;
+	timer->token = token;
+	timer_wheel_.Add(timer);
 }
 
-inline Job* JobSystem::AllocateJob() const
+inline bool JobSystem::OnTimerExpired(TimerWheel::Timer* timer) const
 {
-	thread_local Job job_pool[kMaxJobCount];
-	thread_local uint32_t allocated_jobs = 0;
+	if (timer->period_ticks == 0)
+	{
+		Run(timer->job);
+		return false;
+	}
 
-	uint32_t index = allocated_jobs++;
-	return &job_pool[index & (kMaxJobCount - 1)];
+	if (timer->token && timer->token->IsCancelled())
+	{
+		return false;
+	}
+
+	Job* job = CreateJob(timer->function);
+	SetCancellationToken(job, timer->token);
+	Run(job);
+	return true;
 }
 
-inline JobSystem::WorkStealingQueue* JobSystem::GetWorkerThreadQueue() const
+inline void JobSystem::RunOn(uint32_t worker_index, Job* job) const
 {
-	thread_local WorkStealingQueue queue;
-	return &queue;
+	assert(job);
+
+	// 收件箱满了或索引无效时退化为普通投递,Run会重新打点
+	StampEnqueueTime(job, JobSource::kAffinity);
+	if (worker_index >= worker_inboxes_.size() || worker_index >= worker_count_
+		|| !worker_inboxes_[worker_index]->Push(job))
+	{
+		Run(job);
+	}
+}
+
+inline void JobSystem::RunBlocking(Job* job) const
+{
+	assert(job);
+
+	StampEnqueueTime(job, JobSource::kBlocking);
+	blocking_pool_.Push(job);
+}
+
+inline void JobSystem::BeginBlocking()
+{
+	std::unique_lock lock(compensator_mutex_);
+
+	uint32_t wanted_count = wanted_compensator_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (running_compensator_count_.load(std::memory_order_relaxed) >= wanted_count)
+	{
+		return;
+	}
+
+	if (parked_compensator_count_ > 0)
+	{
+		compensator_condition_.notify_one();
+		return;
+	}
+
+	// 补偿线程用完时只能让工作线程阻塞
+	uint32_t slot = compensator_slot_count_.load(std::memory_order_relaxed);
+	if (slot >= kMaxCompensatingWorkerCount)
+	{
+		return;
+	}
+
+	// promise交给新线程持有,set_value返回前这里就可能醒来离开
+	std::promise<void> registered;
+	std::future<void> registration = registered.get_future();
+	compensators_.emplace_back([this, slot, registered = std::move(registered)]() mutable
+		{
+			CompensatorMain(slot, &registered);
+		});
+
+	// 等待新线程登记好队列后才允许其他线程窃取它,登记不需要compensator_mutex_
+	registration.wait();
+	compensator_slot_count_.store(slot + 1, std::memory_order_release);
+}
+
+inline void JobSystem::EndBlocking()
+{
+	// 多出来的补偿线程执行完手上的作业后自行挂起
+	std::unique_lock lock(compensator_mutex_);
+	wanted_compensator_count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void JobSystem::CompensatorMain(uint32_t slot, std::promise<void>* registered)
+{
+	WorkerIndex() = worker_count_ + slot;
+	work_queues_[WorkerIndex()] = GetWorkerThreadQueue();
+	registered->set_value();
+
+	std::unique_lock lock(compensator_mutex_);
+	running_compensator_count_.fetch_add(1, std::memory_order_relaxed);
+	while (start_)
+	{
+		lock.unlock();
+		while (start_ && running_compensator_count_.load(std::memory_order_relaxed) <= wanted_compensator_count_.load(std::memory_order_relaxed))
+		{
+			Job* job = GetJob();
+			if (job)
+			{
+				Execute(job);
+			}
+		}
+		lock.lock();
+
+		if (!start_ || running_compensator_count_ <= wanted_compensator_count_)
+		{
+			continue;
+		}
+
+		running_compensator_count_.fetch_sub(1, std::memory_order_relaxed);
+		++parked_compensator_count_;
+		lock.unlock();
+
+		// 挂起前执行完自己队列里的作业,其他线程只能窃取,不能指望它们收尾
+		while (Job* job = GetWorkerThreadQueue()->Pop())
+		{
+			Execute(job);
+		}
+
+		lock.lock();
+		JOB_SYSTEM_TRACE(kParkBegin, nullptr, WorkerIndex());
+		CountStat(WorkerStatsCounters::kParks);
+		compensator_condition_.wait(lock, [this]()
+			{
+				return !start_ || running_compensator_count_ < wanted_compensator_count_;
+			});
+		JOB_SYSTEM_TRACE(kParkEnd, nullptr, WorkerIndex());
+		CountStat(WorkerStatsCounters::kWakeups);
+		--parked_compensator_count_;
+		running_compensator_count_.fetch_add(1, std::memory_order_relaxed);
+	}
+	running_compensator_count_.fetch_sub(1, std::memory_order_relaxed);
+	JOB_SYSTEM_TRACE(kIdleEnd, nullptr, WorkerIndex());
+}
+
+inline void JobSystem::Wait(const JobCounter* counter, int32_t value) const
+{
+	assert(counter);
+
+	JOB_SYSTEM_TRACE(kWaitBegin, counter, WorkerIndex());
+	auto wait_begin = std::chrono::steady_clock::now();
+	WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire);
+	if (analyzer)
+	{
+		analyzer->OnWaitBegin();
+	}
+
+	while (counter->value_.load(std::memory_order_seq_cst) > value
+		|| counter->pending_decrements_.load(std::memory_order_seq_cst) != 0)
+	{
+		Job* next_job = GetJob();
+		if (next_job)
+		{
+			Execute(next_job);
+		}
+	}
+	if (analyzer)
+	{
+		analyzer->OnWaitEnd();
+	}
+	CountStat(WorkerStatsCounters::kWaitTimeNs, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_begin).count());
+	JOB_SYSTEM_TRACE(kWaitEnd, counter, WorkerIndex());
+
+	if (counter->has_exception_.load(std::memory_order_acquire))
+	{
+		std::exception_ptr exception;
+		{
+			std::unique_lock lock(counter->mutex_);
+			exception = std::move(counter->exception_);
+			counter->exception_ = nullptr;
+			counter->has_exception_.store(false, std::memory_order_relaxed);
+		}
+
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+}
+
+inline void JobSystem::Wait(const Job* job) const
+{
+	// 等待作业完成,同时可以做其他任何工作
+	JOB_SYSTEM_TRACE(kWaitBegin, job, WorkerIndex());
+	auto wait_begin = std::chrono::steady_clock::now();
+	WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire);
+	if (analyzer)
+	{
+		analyzer->OnWaitBegin();
+	}
+
+	while (!HasJobCompleted(job))
+	{
+		Job* next_job = GetJob();
+		if (next_job)
+		{
+			Execute(next_job);
+		}
+	}
+	if (analyzer)
+	{
+		analyzer->OnWaitEnd();
+	}
+	CountStat(WorkerStatsCounters::kWaitTimeNs, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_begin).count());
+	JOB_SYSTEM_TRACE(kWaitEnd, job, WorkerIndex());
+
+	// 取走异常,之后对同一个作业的Wait不再重复抛出
+	if (job->has_exception.exchange(false, std::memory_order_acq_rel))
+	{
+		std::rethrow_exception(job->exception);
+	}
+}
+
+inline void JobSystem::AttachChild(Job* parent, Job* job) const
+{
+	job->parent = parent;
+	job->cancellation = parent->cancellation;
+	job->category = parent->category;
+
+	if (WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire))
+	{
+		analyzer->OnAttachChild(parent, job);
+	}
+
+	if (parent->fan_in)
+	{
+		// 优先使用创建线程自己的槽位,外部线程轮流分散到各个槽位
+		uint32_t slot_index = WorkerIndex();
+		if (slot_index == kInvalidWorkerIndex)
+		{
+			thread_local uint32_t round_robin = 0;
+			slot_index = round_robin++;
+		}
+
+		job->fan_in_slot = parent->fan_in->GetSlot(slot_index);
+		if (!FanInCounter::Arrive(job->fan_in_slot))
+		{
+			return;
+		}
+	}
+
+	parent->unfinished_jobs.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void JobSystem::Finish(Job* job) const
+{
+	assert(job);
+
+	// 计数归零后等待线程会立刻返回,调用方提供的作业存储(如TaskGroup)随时可能被释放,
+	// 所以归零之后不能再访问job,需要的字段提前取出
+	Job* parent = job->parent;
+	std::atomic_int32_t* fan_in_slot = job->fan_in_slot;
+	JobCounter* counter = job->counter;
+	int32_t continuation_count = job->continuation_count.load(std::memory_order_relaxed);
+	Job* continuations[Job::kMaxContinuationCount];
+	for (int32_t i = 0; i < continuation_count; ++i)
+	{
+		continuations[i] = job->continuations[i];
+	}
+
+	int32_t unfinished_jobs = job->unfinished_jobs.fetch_sub(1, std::memory_order_acq_rel);
+	if (--unfinished_jobs == 0)
+	{
+		if (parent)
+		{
+			// 父作业完成前job的存储一定有效,可以在这里读取异常.异常要在结算父作业之前写入
+			if (job->has_exception.load(std::memory_order_acquire))
+			{
+				SetException(parent, job->exception);
+			}
+
+			// 挂在扇入计数器上的子作业只有最后一个离开槽位的才结算父作业
+			if (fan_in_slot == nullptr || FanInCounter::Depart(fan_in_slot))
+			{
+				Finish(parent);
+			}
+		}
+
+		for (int32_t i = 0; i < continuation_count; ++i)
+		{
+			Run(continuations[i]);
+		}
+
+		if (counter)
+		{
+			// 同父作业,异常要在计数器减一之前记录
+			if (job->has_exception.load(std::memory_order_acquire))
+			{
+				SetCounterException(counter, job->exception);
+			}
+			DecrementCounter(counter);
+		}
+	}
+}
+
+inline void JobSystem::DecrementCounter(JobCounter* counter) const
+{
+	counter->pending_decrements_.fetch_add(1, std::memory_order_seq_cst);
+	counter->value_.fetch_sub(1, std::memory_order_seq_cst);
+	if (counter->waiter_count_.load(std::memory_order_seq_cst) == 0)
+	{
+		counter->pending_decrements_.fetch_sub(1, std::memory_order_release);
+		return;
+	}
+
+	thread_local std::vector<Job*> ready_jobs;
+	{
+		std::unique_lock lock(counter->mutex_);
+
+		int32_t value = counter->value_.load(std::memory_order_seq_cst);
+		auto& waiters = counter->waiters_;
+		for (size_t i = 0; i < waiters.size();)
+		{
+			if (value <= waiters[i].first)
+			{
+				ready_jobs.push_back(waiters[i].second);
+				waiters[i] = waiters.back();
+				waiters.pop_back();
+				counter->waiter_count_.fetch_sub(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+	counter->pending_decrements_.fetch_sub(1, std::memory_order_release);
+
+	// 在锁外投递,避免作业被其他线程窃取后立刻回到同一个计数器上竞争锁
+	for (Job* job : ready_jobs)
+	{
+		Run(job);
+	}
+	ready_jobs.clear();
+}
+
+inline void JobSystem::SetException(Job* job, const std::exception_ptr& exception) const
+{
+	// 只保留第一个异常
+	if (!job->has_exception.exchange(true, std::memory_order_acq_rel))
+	{
+		job->exception = exception;
+	}
+
+	if (job->cancellation && job->cancellation->IsCancelOnException())
+	{
+		job->cancellation->Cancel();
+	}
+}
+
+inline void JobSystem::SetCounterException(JobCounter* counter, const std::exception_ptr& exception) const
+{
+	// 只保留第一个异常
+	std::unique_lock lock(counter->mutex_);
+	if (!counter->exception_)
+	{
+		counter->exception_ = exception;
+	}
+	counter->has_exception_.store(true, std::memory_order_release);
+}
+
+inline uint32_t JobSystem::GenerateRandomNumber(uint32_t min, uint32_t max) const
+{
+	if(!work_queues_[0]->IsEmpty())
+	{
+		return 0;
+	}
+
+	std::uniform_int_distribution<uint32_t> u(min, max - 1);
+	return u(random_engine_);
+}
+
+inline Job* JobSystem::GetJob() const
+{
+	WorkStealingQueue* queue = GetWorkerThreadQueue();
+
+	Job* job = queue->Pop();
+	if (job)
+	{
+		CountStat(WorkerStatsCounters::kLocalPops);
+		return job;
+	}
+
+	// 指定给本线程的作业
+	uint32_t worker_index = WorkerIndex();
+	if (worker_index < worker_inboxes_.size() && !worker_inboxes_[worker_index]->IsEmpty()
+		&& worker_inboxes_[worker_index]->Pop(job))
+	{
+		CountStat(WorkerStatsCounters::kLocalPops);
+		return job;
+	}
+
+	if (!injection_queue_.IsEmpty() && injection_queue_.Pop(job))
+	{
+		CountStat(WorkerStatsCounters::kInjectionPulls);
+		return job;
+	}
+
+	if (job == nullptr)
+	{
+		//当前线程的工作队列是空的，尝试从其他队列中窃取
+		uint32_t queue_count = worker_count_ + compensator_slot_count_.load(std::memory_order_acquire);
+		uint32_t random_index = GenerateRandomNumber(0, queue_count);
+		WorkStealingQueue* steal_queue = work_queues_[random_index];
+		if (steal_queue == queue)
+		{
+			return GetIdleJob();
+		}
+
+		CountStat(WorkerStatsCounters::kStealAttempts);
+		Job* stolen_job = steal_queue->Steal();
+		if (stolen_job == nullptr)
+		{
+			JOB_SYSTEM_TRACE(kStealFail, nullptr, worker_index);
+
+			// 目标线程忙不过来时,指定给它的作业也可以被窃取
+			if (random_index < worker_inboxes_.size())
+			{
+				MpmcQueue<Job*>* inbox = worker_inboxes_[random_index].get();
+				if (!inbox->IsEmpty() && inbox->Pop(stolen_job))
+				{
+					CountStat(WorkerStatsCounters::kStealSuccesses);
+					return stolen_job;
+				}
+			}
+
+			StealDemand& demand = steal_demands_[random_index];
+			if (demand.listener_count.load(std::memory_order_relaxed) != 0 && !demand.value.load(std::memory_order_relaxed))
+			{
+				demand.value.store(true, std::memory_order_relaxed);
+			}
+			return GetIdleJob();
+		}
+
+		JOB_SYSTEM_TRACE(kStealSuccess, stolen_job, worker_index);
+		CountStat(WorkerStatsCounters::kStealSuccesses);
+		return stolen_job;
+	}
+
+	return job;
+}
+
+inline Job* JobSystem::GetIdleJob() const
+{
+	// 空闲的工作线程负责推进时间轮,到期的作业批量压入本线程的队列
+	if (WorkerIndex() != kInvalidWorkerIndex)
+	{
+		auto expired_count = timer_wheel_.Advance([this](TimerWheel::Timer* timer)
+			{
+				return OnTimerExpired(timer);
+			});
+		if (expired_count > 0)
+		{
+			return GetWorkerThreadQueue()->Pop();
+		}
+
+		if (RunIdleHandlers())
+		{
+			return GetWorkerThreadQueue()->Pop();
+		}
+	}
+
+	JOB_SYSTEM_TRACE(kIdleBegin, nullptr, WorkerIndex());
+	CountStat(WorkerStatsCounters::kIdleSpins);
+	std::this_thread::yield();
+	return nullptr;
+}
+
+inline bool JobSystem::RunIdleHandlers() const
+{
+	if (idle_handler_count_.load(std::memory_order_acquire) == 0)
+	{
+		return false;
+	}
+
+	// 正在注册或注销时直接跳过,不阻塞空闲线程
+	std::shared_lock lock(idle_mutex_, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		return false;
+	}
+
+	bool busy = false;
+	for (auto& handler : idle_handlers_)
+	{
+		busy |= handler.second();
+	}
+	return busy;
+}
+
+inline void JobSystem::Execute(Job* job) const
+{
+	CountStat(WorkerStatsCounters::kJobsExecuted);
+	if (job->enqueue_time != 0)
+	{
+		RecordLatency(job);
+	}
+
+	// 已取消的作业不再执行,但仍要结算计数,保证父作业和等待者能正常完成
+	if (!IsCancelled(job))
+	{
+		Job*& current_job = CurrentJob();
+		Job* previous_job = current_job;
+		current_job = job;
+		JOB_SYSTEM_TRACE(kJobBegin, job, WorkerIndex());
+
+		CategoryTiming timing;
+		bool accounting = category_accounting_.load(std::memory_order_relaxed);
+		if (accounting)
+		{
+			BeginCategoryTiming(timing);
+		}
+
+		WorkSpanAnalyzer* analyzer = work_span_analyzer_.load(std::memory_order_acquire);
+		if (analyzer)
+		{
+			analyzer->OnExecuteBegin(job);
+		}
+
+		try
+		{
+			job->function(job);
+		}
+		catch (...)
+		{
+			// 异常不能穿出Execute,否则Finish被跳过,父作业永远无法完成
+			SetException(job, std::current_exception());
+		}
+
+		if (analyzer)
+		{
+			analyzer->OnExecuteEnd(job);
+		}
+
+		if (accounting)
+		{
+			EndCategoryTiming(job, timing);
+		}
+		JOB_SYSTEM_TRACE(kJobEnd, job, WorkerIndex());
+		current_job = previous_job;
+	}
+	job->function = nullptr;
+	Finish(job);
+}
+
+inline SchedulerStats JobSystem::GetStats() const
+{
+	SchedulerStats stats;
+	if (stats_counter_count_ == 0)
+	{
+		return stats;
+	}
+
+	uint32_t worker_count = worker_count_ + compensator_slot_count_.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < worker_count; ++i)
+	{
+		stats.workers.push_back(stats_counters_[i].Snapshot());
+		stats.total += stats.workers.back();
+	}
+
+	stats.workers.push_back(stats_counters_[stats_counter_count_ - 1].Snapshot());
+	stats.total += stats.workers.back();
+	return stats;
+}
+
+inline void JobSystem::ResetStats() const
+{
+	for (uint32_t i = 0; i < stats_counter_count_; ++i)
+	{
+		stats_counters_[i].Reset();
+	}
+}
+
+inline LatencyStats JobSystem::GetLatencyStats() const
+{
+	constexpr uint32_t kSourceCount = static_cast<uint32_t>(JobSource::kCount);
+
+	LatencyStats stats;
+	if (stats_counter_count_ == 0)
+	{
+		return stats;
+	}
+
+	auto add_worker = [this, &stats](uint32_t index)
+	{
+		stats.workers.emplace_back();
+		for (uint32_t source = 0; source < kSourceCount; ++source)
+		{
+			const LatencyHistogram& histogram = latency_histograms_[index * kSourceCount + source];
+			stats.workers.back()[source] = histogram;
+			stats.sources[source].Merge(histogram);
+			stats.total.Merge(histogram);
+		}
+	};
+
+	uint32_t worker_count = worker_count_ + compensator_slot_count_.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < worker_count; ++i)
+	{
+		add_worker(i);
+	}
+	add_worker(stats_counter_count_ - 1);
+	return stats;
+}
+
+inline void JobSystem::ResetLatencyStats() const
+{
+	for (uint32_t i = 0; i < stats_counter_count_ * static_cast<uint32_t>(JobSource::kCount); ++i)
+	{
+		latency_histograms_[i].Reset();
+	}
+}
+
+inline void JobSystem::StampEnqueueTime(Job* job, JobSource source) const
+{
+	if (latency_tracking_.load(std::memory_order_relaxed))
+	{
+		job->source = source;
+		job->enqueue_time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+inline void JobSystem::RecordLatency(Job* job) const
+{
+	uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+	uint64_t latency = now > job->enqueue_time ? now - job->enqueue_time : 0;
+	job->enqueue_time = 0;
+
+	if (stats_counter_count_ == 0)
+	{
+		return;
+	}
+
+	// 非工作线程(阻塞线程池等)共享最后一组直方图
+	uint32_t worker_index = WorkerIndex();
+	uint32_t slot = worker_index < stats_counter_count_ - 1 ? worker_index : stats_counter_count_ - 1;
+	latency_histograms_[slot * static_cast<uint32_t>(JobSource::kCount) + static_cast<uint32_t>(job->source)]
+		.Record(latency, slot == stats_counter_count_ - 1);
+}
+
+inline void JobSystem::EnableCategoryAccounting(bool enable) const
+{
+	if (enable)
+	{
+		AllocateCategoryCounters();
+	}
+	category_accounting_.store(enable, std::memory_order_relaxed);
+}
+
+inline void JobSystem::AllocateCategoryCounters() const
+{
+	// Start之前开启时线程数还不知道,由Start分配
+	std::unique_lock lock(category_counters_mutex_);
+	if (stats_counter_count_ != 0 && !category_counter_storage_)
+	{
+		category_counter_storage_ = std::make_unique<JobCategoryCounters[]>(stats_counter_count_ * JobCategoryRegistry::kMaxCategoryCount);
+		category_counters_.store(category_counter_storage_.get(), std::memory_order_release);
+	}
+}
+
+inline std::vector<JobCategoryStats> JobSystem::GetCategoryStats() const
+{
+	std::vector<JobCategoryStats> stats;
+	JobCategoryCounters* category_counters = category_counters_.load(std::memory_order_acquire);
+	if (category_counters == nullptr)
+	{
+		return stats;
+	}
+
+	uint32_t category_count = JobCategoryRegistry::Get().GetCount();
+	for (uint32_t category = 0; category < category_count; ++category)
+	{
+		JobCategoryStats category_stats;
+		for (uint32_t i = 0; i < stats_counter_count_; ++i)
+		{
+			category_counters[i * JobCategoryRegistry::kMaxCategoryCount + category].AddTo(category_stats);
+		}
+
+		if (category_stats.count)
+		{
+			category_stats.id = category;
+			category_stats.name = JobCategoryRegistry::Get().GetName(category);
+			stats.push_back(std::move(category_stats));
+		}
+	}
+	return stats;
+}
+
+inline void JobSystem::ResetCategoryStats() const
+{
+	JobCategoryCounters* category_counters = category_counters_.load(std::memory_order_acquire);
+	if (category_counters == nullptr)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < stats_counter_count_ * JobCategoryRegistry::kMaxCategoryCount; ++i)
+	{
+		category_counters[i].Reset();
+	}
+}
+
+inline bool JobSystem::EnableHardwareCounters(bool enable) const
+{
+	if (enable && PerfCounterGroup::GetThreadGroup() == nullptr)
+	{
+		hardware_counters_.store(false, std::memory_order_relaxed);
+		return false;
+	}
+
+	hardware_counters_.store(enable, std::memory_order_relaxed);
+	return true;
+}
+
+inline void JobSystem::BeginCategoryTiming(CategoryTiming& timing) const
+{
+	JobCategorySample& nested = NestedCategorySample();
+	timing.outer_nested = nested;
+	nested = JobCategorySample();
+
+	// 先读硬件计数器再读时钟,结束时顺序相反,read的开销不计入作业时间
+	timing.hardware = hardware_counters_.load(std::memory_order_relaxed) ? PerfCounterGroup::GetThreadGroup() : nullptr;
+	if (timing.hardware && !timing.hardware->Read(timing.begin.hardware))
+	{
+		timing.hardware = nullptr;
+	}
+
+	timing.begin.cpu_ns = ReadThreadCpuTimeNs();
+	timing.begin.wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline void JobSystem::EndCategoryTiming(const Job* job, const CategoryTiming& timing) const
+{
+	JobCategorySample end;
+	end.wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+	end.cpu_ns = ReadThreadCpuTimeNs();
+	bool hardware = timing.hardware && timing.hardware->Read(end.hardware);
+	if (!hardware)
+	{
+		end.hardware = timing.begin.hardware;
+	}
+
+	// 扣除作业内部Wait时嵌套执行的其他作业,再把本作业的总量计入外层
+	JobCategorySample elapsed = end - timing.begin;
+	JobCategorySample& nested = NestedCategorySample();
+	JobCategorySample self = elapsed - nested;
+	nested = timing.outer_nested + elapsed;
+
+	JobCategoryCounters* category_counters = category_counters_.load(std::memory_order_acquire);
+	if (category_counters == nullptr || job->category >= JobCategoryRegistry::kMaxCategoryCount)
+	{
+		return;
+	}
+
+	uint32_t worker_index = WorkerIndex();
+	uint32_t slot = worker_index < stats_counter_count_ - 1 ? worker_index : stats_counter_count_ - 1;
+	bool shared = slot == stats_counter_count_ - 1;
+
+	JobCategoryCounters& counters = category_counters[slot * JobCategoryRegistry::kMaxCategoryCount + job->category];
+	counters.Add(JobCategoryCounters::kCount, 1, shared);
+	counters.Add(JobCategoryCounters::kTotalNs, self.wall_ns, shared);
+	counters.Max(JobCategoryCounters::kMaxNs, self.wall_ns, shared);
+	counters.Add(JobCategoryCounters::kCpuNs, self.cpu_ns, shared);
+
+	if (hardware)
+	{
+		counters.Add(JobCategoryCounters::kHardwareCount, 1, shared);
+		counters.Add(JobCategoryCounters::kCycles, self.hardware.values[PerfCounterGroup::kCycles], shared);
+		counters.Add(JobCategoryCounters::kInstructions, self.hardware.values[PerfCounterGroup::kInstructions], shared);
+		counters.Add(JobCategoryCounters::kCacheMisses, self.hardware.values[PerfCounterGroup::kCacheMisses], shared);
+		counters.Add(JobCategoryCounters::kBranchMisses, self.hardware.values[PerfCounterGroup::kBranchMisses], shared);
+	}
+}
+
+inline WorkerStatsCounters* JobSystem::GetStatsCounters() const
+{
+	if (stats_counter_count_ == 0)
+	{
+		return nullptr;
+	}
+
+	uint32_t worker_index = WorkerIndex();
+	return &stats_counters_[worker_index < stats_counter_count_ - 1 ? worker_index : stats_counter_count_ - 1];
+}
+
+inline void JobSystem::CountStat(WorkerStatsCounters::Counter counter, uint64_t value) const
+{
+	WorkerStatsCounters* counters = GetStatsCounters();
+	if (counters)
+	{
+		counters->Add(counter, value, counters == &stats_counters_[stats_counter_count_ - 1]);
+	}
+}
+
+inline bool JobSystem::HasJobCompleted(const Job* job) const noexcept
+{
+	assert(job);
+
+	return job->unfinished_jobs.load(std::memory_order_acquire) == 0;
+}
+
+inline Job* JobSystem::AllocateJob() const
+{
+	// 非工作线程可能在作业执行前就退出,不能使用线程局部的作业池
+	if (WorkerIndex() == kInvalidWorkerIndex)
+	{
+		static Job shared_job_pool[kMaxJobCount];
+		static std::atomic_uint32_t shared_allocated_jobs = 0;
+
+		for (;;)
+		{
+			// 多个非工作线程共用,用CAS把计数从0改为1占住槽位,InitializeJob会再写一次1
+			for (uint32_t i = 0; i < kMaxJobCount; ++i)
+			{
+				uint32_t index = shared_allocated_jobs.fetch_add(1, std::memory_order_relaxed);
+				Job* job = &shared_job_pool[index & (kMaxJobCount - 1)];
+				int32_t unfinished_jobs = 0;
+				if (job->unfinished_jobs.load(std::memory_order_relaxed) == 0
+					&& job->unfinished_jobs.compare_exchange_strong(unfinished_jobs, 1, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					return job;
+				}
+			}
+
+			HelpWhileJobPoolExhausted();
+		}
+	}
+
+	thread_local Job job_pool[kMaxJobCount];
+	thread_local uint32_t allocated_jobs = 0;
+
+	// 环形分配时跳过还没完成的作业,大的拆分树不会覆盖仍在等待子作业的祖先
+	for (;;)
+	{
+		for (uint32_t i = 0; i < kMaxJobCount; ++i)
+		{
+			uint32_t index = allocated_jobs++;
+			Job* job = &job_pool[index & (kMaxJobCount - 1)];
+			if (job->unfinished_jobs.load(std::memory_order_acquire) == 0)
+			{
+				return job;
+			}
+		}
+
+		HelpWhileJobPoolExhausted();
+	}
+}
+
+inline void JobSystem::HelpWhileJobPoolExhausted() const
+{
+	// 作业池满了:不返回空指针,先帮忙执行一个作业,等有作业完成、槽位空出来后再重试
+	Job* job = GetJob();
+	if (job)
+	{
+		Execute(job);
+	}
+}
+
+inline JobSystem::WorkStealingQueue* JobSystem::GetWorkerThreadQueue() const
+{
+	thread_local WorkStealingQueue queue;
+	return &queue;
+}
+
+inline uint32_t& JobSystem::WorkerIndex()
+{
+	thread_local uint32_t index = kInvalidWorkerIndex;
+	return index;
+}
+
+inline Job*& JobSystem::CurrentJob()
+{
+	thread_local Job* job = nullptr;
+	return job;
+}
+
+inline JobCategorySample& JobSystem::NestedCategorySample()
+{
+	thread_local JobCategorySample sample;
+	return sample;
 }
\ No newline at end of file
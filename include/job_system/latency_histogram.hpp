@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "job.hpp"
+
+// HDR风格的对数直方图:每个2的幂区间再线性分成kSubBucketCount个桶,相对误差不超过1/kSubBucketCount
+// 计数器只由所属线程写入时用relaxed的读-写代替原子加法,多线程共享时用原子加法
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t kSubBucketBits = 4;
+	static constexpr uint32_t kSubBucketCount = 1 << kSubBucketBits;
+	static constexpr uint32_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+	LatencyHistogram()
+	{
+		Reset();
+	}
+
+	LatencyHistogram(const LatencyHistogram& other)
+	{
+		*this = other;
+	}
+
+	LatencyHistogram& operator=(const LatencyHistogram& other)
+	{
+		for (uint32_t i = 0; i < kBucketCount; ++i)
+		{
+			counts_[i].store(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		count_.store(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		sum_.store(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		max_.store(other.max_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+	}
+
+	static uint32_t GetBucketIndex(uint64_t value)
+	{
+		if (value < kSubBucketCount)
+		{
+			return static_cast<uint32_t>(value);
+		}
+
+		uint32_t shift = HighestBit(value) - kSubBucketBits;
+		uint32_t sub_bucket = static_cast<uint32_t>(value >> shift) & (kSubBucketCount - 1);
+		return (shift + 1) * kSubBucketCount + sub_bucket;
+	}
+
+	// 桶内的最大值
+	static uint64_t GetBucketUpperBound(uint32_t index)
+	{
+		if (index < kSubBucketCount)
+		{
+			return index;
+		}
+
+		uint32_t shift = index / kSubBucketCount - 1;
+		uint64_t sub_bucket = index % kSubBucketCount;
+		return ((kSubBucketCount + sub_bucket + 1) << shift) - 1;
+	}
+
+	// shared为false时只能由所属线程调用
+	void Record(uint64_t value, bool shared)
+	{
+		uint32_t index = GetBucketIndex(value);
+		if (shared)
+		{
+			counts_[index].fetch_add(1, std::memory_order_relaxed);
+			count_.fetch_add(1, std::memory_order_relaxed);
+			sum_.fetch_add(value, std::memory_order_relaxed);
+
+			uint64_t max = max_.load(std::memory_order_relaxed);
+			while (max < value && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+		}
+		else
+		{
+			counts_[index].store(counts_[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+			if (max_.load(std::memory_order_relaxed) < value)
+			{
+				max_.store(value, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// 不能与Record并发修改同一个直方图
+	void Merge(const LatencyHistogram& other)
+	{
+		for (uint32_t i = 0; i < kBucketCount; ++i)
+		{
+			counts_[i].store(counts_[i].load(std::memory_order_relaxed) + other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		count_.store(count_.load(std::memory_order_relaxed) + other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		sum_.store(sum_.load(std::memory_order_relaxed) + other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		max_.store(std::max(max_.load(std::memory_order_relaxed), other.max_.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+	}
+
+	void Reset()
+	{
+		for (auto& count : counts_)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+		count_.store(0, std::memory_order_relaxed);
+		sum_.store(0, std::memory_order_relaxed);
+		max_.store(0, std::memory_order_relaxed);
+	}
+
+	uint64_t GetCount() const { return count_.load(std::memory_order_relaxed); }
+	uint64_t GetMax() const { return max_.load(std::memory_order_relaxed); }
+
+	double GetMean() const
+	{
+		uint64_t count = GetCount();
+		return count ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / count : 0.0;
+	}
+
+	// percentile取值0~100,例如99.9;返回所在桶的上界,不超过记录到的最大值
+	uint64_t GetPercentile(double percentile) const
+	{
+		uint64_t count = GetCount();
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		uint64_t target = static_cast<uint64_t>(std::ceil(std::min(percentile, 100.0) / 100.0 * count));
+		target = std::max<uint64_t>(target, 1);
+
+		uint64_t accumulated = 0;
+		for (uint32_t i = 0; i < kBucketCount; ++i)
+		{
+			accumulated += counts_[i].load(std::memory_order_relaxed);
+			if (accumulated >= target)
+			{
+				return std::min(GetBucketUpperBound(i), GetMax());
+			}
+		}
+		return GetMax();
+	}
+private:
+	static uint32_t HighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	std::atomic_uint64_t counts_[kBucketCount];
+	std::atomic_uint64_t count_;
+	std::atomic_uint64_t sum_;
+	std::atomic_uint64_t max_;
+};
+
+// GetLatencyStats返回的排队延迟快照(纳秒),按投递来源(JobSource)分开统计
+// workers按执行作业的工作线程索引排列,排列方式同SchedulerStats::workers
+struct LatencyStats
+{
+	using SourceHistograms = std::array<LatencyHistogram, static_cast<size_t>(JobSource::kCount)>;
+
+	std::vector<SourceHistograms> workers;
+	// 所有线程按来源汇总
+	SourceHistograms sources;
+	LatencyHistogram total;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// 只读内存映射文件,打开时提示内核顺序访问并提前预读
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept
+		: data_(std::exchange(other.data_, nullptr))
+		, size_(std::exchange(other.size_, 0))
+	{
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+	// 空文件也算打开成功,数据为空
+	bool Open(const std::string& path);
+
+	void Close();
+
+	std::string_view GetData() const { return std::string_view(data_, size_); }
+
+	size_t GetSize() const { return size_; }
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+};
+
+inline bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+	{
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (data == nullptr)
+	{
+		return false;
+	}
+
+	data_ = static_cast<const char*>(data);
+	size_ = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	if (st.st_size == 0)
+	{
+		close(fd);
+		return true;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// 映射建立后文件描述符就不再需要了
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+	madvise(data, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+
+	data_ = static_cast<const char*>(data);
+	size_ = static_cast<size_t>(st.st_size);
+#endif
+	return true;
+}
+
+inline void MappedFile::Close()
+{
+	if (data_ == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data_);
+#else
+	munmap(const_cast<char*>(data_), size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// 有界多生产者多消费者无锁队列(Vyukov),容量必须是2的幂
+template<class T>
+class MpmcQueue
+{
+public:
+	static constexpr size_t kCacheLineSize = 64;
+
+	explicit MpmcQueue(size_t capacity)
+		: mask_(capacity - 1)
+		, cells_(new Cell[capacity])
+		, enqueue_position_(0)
+		, dequeue_position_(0)
+	{
+		assert(capacity >= 2 && (capacity & mask_) == 0);
+
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcQueue(const MpmcQueue&) = delete;
+	MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+	size_t GetCapacity() const { return mask_ + 1; }
+
+	//可能不准,但是无影响
+	bool IsEmpty() const
+	{
+		return enqueue_position_.load(std::memory_order_relaxed) <= dequeue_position_.load(std::memory_order_relaxed);
+	}
+
+	//可能不准,但是无影响
+	bool IsFull() const
+	{
+		return enqueue_position_.load(std::memory_order_relaxed) - dequeue_position_.load(std::memory_order_relaxed) > mask_;
+	}
+
+	template<class U>
+	bool Push(U&& value)
+	{
+		size_t position = enqueue_position_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells_[position & mask_];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (diff == 0)
+			{
+				if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// 队列已满
+				return false;
+			}
+			else
+			{
+				position = enqueue_position_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->value = std::forward<U>(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& value)
+	{
+		size_t position = dequeue_position_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells_[position & mask_];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (diff == 0)
+			{
+				if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// 队列为空
+				return false;
+			}
+			else
+			{
+				position = dequeue_position_.load(std::memory_order_relaxed);
+			}
+		}
+
+		value = std::move(cell->value);
+		cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	struct Cell
+	{
+		std::atomic_size_t sequence;
+		T value;
+	};
+
+	const size_t mask_;
+	std::unique_ptr<Cell[]> cells_;
+	alignas(kCacheLineSize) std::atomic_size_t enqueue_position_;
+	alignas(kCacheLineSize) std::atomic_size_t dequeue_position_;
+};
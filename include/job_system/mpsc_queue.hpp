@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+
+struct MpscNode
+{
+	std::atomic<MpscNode*> next{ nullptr };
+};
+
+// 侵入式无界多生产者单消费者无锁队列(Vyukov),T必须继承MpscNode
+// Pop可能在生产者压入到一半时返回nullptr,调用方需要结合自己的计数判断是否稍后重试
+template<class T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+		: head_(&stub_)
+		, tail_(&stub_)
+	{
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	// 可以在任意线程调用
+	void Push(T* node)
+	{
+		Push(static_cast<MpscNode*>(node));
+	}
+
+	// 只能由单个消费者调用
+	T* Pop()
+	{
+		MpscNode* tail = tail_;
+		MpscNode* next = tail->next.load(std::memory_order_acquire);
+		if (tail == &stub_)
+		{
+			if (next == nullptr)
+			{
+				return nullptr;
+			}
+			tail_ = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next)
+		{
+			tail_ = next;
+			return static_cast<T*>(tail);
+		}
+
+		// 生产者已经交换了head_但还没有链接next
+		if (tail != head_.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+
+		Push(&stub_);
+		next = tail->next.load(std::memory_order_acquire);
+		if (next)
+		{
+			tail_ = next;
+			return static_cast<T*>(tail);
+		}
+
+		return nullptr;
+	}
+private:
+	void Push(MpscNode* node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	std::atomic<MpscNode*> head_;
+	MpscNode* tail_;
+	MpscNode stub_;
+};
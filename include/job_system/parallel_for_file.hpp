@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "job_system.hpp"
+#include "mapped_file.hpp"
+
+// 返回不小于offset的第一个记录起始位置,没有更多记录时返回data.size()
+using RecordBoundaryFunction = std::function<size_t(std::string_view data, size_t offset)>;
+
+// 默认按行切分
+inline size_t FindNextLine(std::string_view data, size_t offset)
+{
+	if (offset == 0)
+	{
+		return 0;
+	}
+
+	size_t pos = data.find('\n', offset - 1);
+	return pos == std::string_view::npos ? data.size() : pos + 1;
+}
+
+// 把data切成大约chunk_size大小的块,块的边界总是落在记录边界上
+inline std::vector<std::string_view> SplitRecords(std::string_view data, size_t chunk_size, const RecordBoundaryFunction& boundary)
+{
+	assert(chunk_size >= 1);
+
+	std::vector<std::string_view> chunks;
+	chunks.reserve(data.size() / chunk_size + 1);
+
+	size_t begin = 0;
+	while (begin < data.size())
+	{
+		size_t end = data.size();
+		if (end - begin > chunk_size)
+		{
+			end = boundary(data, begin + chunk_size);
+			// 记录比块大时整条记录作为一个块
+			if (end <= begin || end > data.size())
+			{
+				end = data.size();
+			}
+		}
+
+		chunks.push_back(data.substr(begin, end - begin));
+		begin = end;
+	}
+	return chunks;
+}
+
+// 映射文件并把切好的块交给作业并行处理,块直接指向映射的内存,不做拷贝
+// 文件无法打开时返回false,处理中抛出的异常会重新抛出
+inline bool ParallelForFile(const std::string& path, size_t chunk_size, const std::function<void(std::string_view)>& function,
+	const RecordBoundaryFunction& boundary = FindNextLine, JobSystem& job_system = JobSystem::Get())
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		return false;
+	}
+
+	std::vector<std::string_view> chunks = SplitRecords(file.GetData(), chunk_size, boundary ? boundary : FindNextLine);
+	if (chunks.empty())
+	{
+		return true;
+	}
+
+	Job* job = job_system.ParallelFor<std::string_view, uint32_t>(chunks.data(), static_cast<uint32_t>(chunks.size()), [&function](std::string_view* chunk, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				function(chunk[i]);
+			}
+		}, 1);
+	job_system.Run(job);
+	job_system.Wait(job);
+	return true;
+}
+
+// 每个块先并行映射成一个结果,再按块在文件中的顺序依次调用reduce合并结果
+template<class Map, class Reduce>
+bool ParallelForFileReduce(const std::string& path, size_t chunk_size, Map map, Reduce reduce,
+	const RecordBoundaryFunction& boundary = FindNextLine, JobSystem& job_system = JobSystem::Get())
+{
+	using Result = std::invoke_result_t<Map&, std::string_view>;
+
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		return false;
+	}
+
+	std::vector<std::string_view> chunks = SplitRecords(file.GetData(), chunk_size, boundary ? boundary : FindNextLine);
+	if (chunks.empty())
+	{
+		return true;
+	}
+
+	std::vector<Result> results(chunks.size());
+	std::string_view* first = chunks.data();
+	Job* job = job_system.ParallelFor<std::string_view, uint32_t>(first, static_cast<uint32_t>(chunks.size()), [&map, &results, first](std::string_view* chunk, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				results[chunk - first + i] = map(chunk[i]);
+			}
+		}, 1);
+	job_system.Run(job);
+	job_system.Wait(job);
+
+	for (auto& result : results)
+	{
+		reduce(std::move(result));
+	}
+	return true;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <utility>
+
+#include <mutex>
+
+// ParallelFor的分割策略
+// ParallelFor开始时调用Begin(count, worker_count)得到本次使用的分割器,分割器随作业复制;
+// 每个作业先问ShouldSplit是否把剩余范围二分成两个子作业,子作业投递到GetAffinity返回的工作线程(kNoAffinity时本地投递);
+// kSplitInPlace为true时只把右半部分作为子作业投递,左半部分留在当前作业里继续执行;
+// 不分时取GetChunkSize个元素用Execute执行,再重新判断剩余部分
+struct PartitionContext
+{
+	static constexpr uint32_t kNoAffinity = UINT32_MAX;
+
+	uint32_t worker_count;
+	// 当前线程的工作线程索引,非工作线程为kNoAffinity
+	uint32_t worker_index;
+	// 当前线程本地队列中的作业数,非工作线程为0
+	uint32_t local_queue_size;
+	// 其他工作线程从本线程窃取失败时置位;只提供给kSplitInPlace的分割器,非工作线程为nullptr
+	std::atomic_bool* steal_demand;
+};
+
+// 固定粒度:元素数超过grain_size就二分,叶子一次执行完.ParallelFor传整数时就是这个分割器
+class FixedPartitioner
+{
+public:
+	static constexpr bool kSplitInPlace = false;
+
+	explicit FixedPartitioner(uint32_t grain_size = 1)
+		: grain_size_(std::max(grain_size, 1u))
+	{
+	}
+
+	FixedPartitioner Begin(uint32_t, uint32_t) const { return *this; }
+
+	bool ShouldSplit(const PartitionContext&, uint32_t, uint32_t count) const { return count > grain_size_; }
+	uint32_t GetChunkSize(uint32_t count) const { return count; }
+	uint32_t GetAffinity(uint32_t, uint32_t) const { return PartitionContext::kNoAffinity; }
+
+	template<class F>
+	void Execute(const PartitionContext&, uint32_t, uint32_t, F&& leaf) const
+	{
+		leaf();
+	}
+private:
+	uint32_t grain_size_;
+};
+
+// 静态分割:按工作线程数均分,每个线程大约一块,之后不再细分
+class StaticPartitioner
+{
+public:
+	FixedPartitioner Begin(uint32_t count, uint32_t worker_count) const
+	{
+		worker_count = std::max(worker_count, 1u);
+		return FixedPartitioner((count + worker_count - 1) / worker_count);
+	}
+};
+
+// 自适应分割,结合两种做法:
+//  - 在线测量每个元素的耗时,叶子一次执行大约target_leaf_ns的元素
+//  - 懒惰二分:只有本地队列空了(作业被窃取走了)才继续二分剩余范围,否则一块一块地顺序执行,每块之间重新判断
+// 测得的耗时保存在共享状态中,同一个分割器对象在多次ParallelFor之间复用时不需要重新学习
+class AutoPartitioner
+{
+public:
+	static constexpr bool kSplitInPlace = false;
+	static constexpr uint64_t kDefaultTargetLeafNs = 20000;
+
+	explicit AutoPartitioner(uint64_t target_leaf_ns = kDefaultTargetLeafNs)
+		: state_(std::make_shared<State>(target_leaf_ns))
+	{
+	}
+
+	AutoPartitioner Begin(uint32_t, uint32_t) const { return *this; }
+
+	bool ShouldSplit(const PartitionContext& context, uint32_t, uint32_t count) const
+	{
+		return context.worker_count > 1 && context.local_queue_size == 0 && count > GetGrainSize();
+	}
+
+	uint32_t GetChunkSize(uint32_t count) const { return std::min(count, GetGrainSize()); }
+	uint32_t GetAffinity(uint32_t, uint32_t) const { return PartitionContext::kNoAffinity; }
+
+	template<class F>
+	void Execute(const PartitionContext&, uint32_t, uint32_t count, F&& leaf) const
+	{
+		auto begin = std::chrono::steady_clock::now();
+		leaf();
+		uint64_t elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - begin).count());
+
+		// 每元素耗时用定点数(1/kScale纳秒)保存,按1/8的权重滑动平均;并发更新丢掉一次样本没有关系
+		uint64_t sample = std::max<uint64_t>(elapsed_ns * kScale / count, 1);
+		uint64_t estimate = state_->item_cost.load(std::memory_order_relaxed);
+		estimate = estimate == 0 ? sample : estimate - estimate / 8 + sample / 8;
+		state_->item_cost.store(std::max<uint64_t>(estimate, 1), std::memory_order_relaxed);
+	}
+
+	// 当前估计的叶子粒度,还没有测量时为1,先用一个元素探测耗时
+	uint32_t GetGrainSize() const
+	{
+		uint64_t item_cost = state_->item_cost.load(std::memory_order_relaxed);
+		if (item_cost == 0)
+		{
+			return 1;
+		}
+
+		uint64_t grain = state_->target_leaf_ns * kScale / item_cost;
+		return static_cast<uint32_t>(std::clamp<uint64_t>(grain, 1, UINT32_MAX));
+	}
+private:
+	static constexpr uint64_t kScale = 1024;
+
+	struct State
+	{
+		explicit State(uint64_t target_leaf_ns)
+			: target_leaf_ns(std::max<uint64_t>(target_leaf_ns, 1))
+			, item_cost(0)
+		{
+		}
+
+		uint64_t target_leaf_ns;
+		std::atomic_uint64_t item_cost;
+	};
+
+	std::shared_ptr<State> state_;
+};
+
+// 亲和分割:按固定粒度(每个工作线程kChunksPerWorker块)二分,记录每一块由哪个工作线程执行;
+// 之后用同一个对象对同样长度的范围再次ParallelFor时,把每一块投递到上次执行它的工作线程的收件箱,
+// 收件箱里的作业仍然可以被窃取.适合每轮迭代都遍历同一个数组的场景,数据留在上次那个核的缓存里
+// 范围长度或工作线程数变化时重新记录;同一个对象不能同时用于两个正在进行的ParallelFor
+class AffinityPartitioner
+{
+public:
+	static constexpr bool kSplitInPlace = false;
+	static constexpr uint32_t kChunksPerWorker = 4;
+
+	AffinityPartitioner()
+		: state_(std::make_shared<State>())
+	{
+	}
+
+	AffinityPartitioner Begin(uint32_t count, uint32_t worker_count) const
+	{
+		State& state = *state_;
+		std::unique_lock lock(state.mutex);
+		if (state.count != count || state.worker_count != worker_count)
+		{
+			state.count = count;
+			state.worker_count = worker_count;
+			state.grain_size = std::max(count / (std::max(worker_count, 1u) * kChunksPerWorker), 1u);
+
+			// 超过grain_size才二分,每块至少(grain_size+1)/2个元素,按这个宽度分桶,不同的块不会落在同一个桶
+			state.bucket_width = std::max((state.grain_size + 1) / 2, 1u);
+			state.bucket_count = count / state.bucket_width + 1;
+			state.affinities = std::make_unique<std::atomic_uint32_t[]>(state.bucket_count);
+			for (uint32_t i = 0; i < state.bucket_count; ++i)
+			{
+				state.affinities[i].store(PartitionContext::kNoAffinity, std::memory_order_relaxed);
+			}
+		}
+		return *this;
+	}
+
+	bool ShouldSplit(const PartitionContext&, uint32_t, uint32_t count) const { return count > state_->grain_size; }
+	uint32_t GetChunkSize(uint32_t count) const { return count; }
+
+	// 子范围投递给上次执行它第一块的工作线程,这个线程继续二分时再把后面的块分派出去
+	uint32_t GetAffinity(uint32_t offset, uint32_t) const
+	{
+		return state_->affinities[offset / state_->bucket_width].load(std::memory_order_relaxed);
+	}
+
+	template<class F>
+	void Execute(const PartitionContext& context, uint32_t offset, uint32_t, F&& leaf) const
+	{
+		state_->affinities[offset / state_->bucket_width].store(context.worker_index, std::memory_order_relaxed);
+		leaf();
+	}
+private:
+	struct State
+	{
+		std::mutex mutex;
+		uint32_t count = UINT32_MAX;
+		uint32_t worker_count = 0;
+		uint32_t grain_size = 1;
+		uint32_t bucket_width = 1;
+		uint32_t bucket_count = 0;
+		std::unique_ptr<std::atomic_uint32_t[]> affinities;
+	};
+
+	std::shared_ptr<State> state_;
+};
+
+// 心跳分割:工作线程一块一块地顺序执行循环,不预先创建作业;
+// 只有心跳到期(距本线程上次分出作业超过heartbeat_ns,且上次分出的作业已经被取走)或有线程来窃取扑空时,
+// 才把剩余范围的右半部分提升为一个可窃取的作业,左半部分继续在当前作业里执行.
+// 创建作业的数量与实际发生的并行成正比,单线程跑完整个循环时只有一个作业.
+// 每块的大小用AutoPartitioner的在线测量控制在poll_ns左右,两次检查之间的延迟不会太长
+class HeartbeatPartitioner
+{
+public:
+	static constexpr bool kSplitInPlace = true;
+	static constexpr uint64_t kDefaultHeartbeatNs = 100000;
+	static constexpr uint64_t kDefaultPollNs = 5000;
+
+	explicit HeartbeatPartitioner(uint64_t heartbeat_ns = kDefaultHeartbeatNs, uint64_t poll_ns = kDefaultPollNs)
+		: heartbeat_ns_(heartbeat_ns)
+		, chunk_partitioner_(poll_ns)
+	{
+	}
+
+	HeartbeatPartitioner Begin(uint32_t, uint32_t) const { return *this; }
+
+	bool ShouldSplit(const PartitionContext& context, uint32_t, uint32_t count) const
+	{
+		if (context.worker_count <= 1 || count <= chunk_partitioner_.GetGrainSize())
+		{
+			return false;
+		}
+
+		// 有线程扑空说明确实需要作业,立即提升
+		if (context.steal_demand && context.steal_demand->load(std::memory_order_relaxed)
+			&& context.steal_demand->exchange(false, std::memory_order_relaxed))
+		{
+			LastBeat() = Now();
+			return true;
+		}
+
+		if (context.local_queue_size != 0)
+		{
+			return false;
+		}
+
+		uint64_t now = Now();
+		uint64_t& last_beat = LastBeat();
+		if (now - last_beat < heartbeat_ns_)
+		{
+			return false;
+		}
+
+		last_beat = now;
+		return true;
+	}
+
+	uint32_t GetChunkSize(uint32_t count) const { return chunk_partitioner_.GetChunkSize(count); }
+	uint32_t GetAffinity(uint32_t, uint32_t) const { return PartitionContext::kNoAffinity; }
+
+	template<class F>
+	void Execute(const PartitionContext& context, uint32_t offset, uint32_t count, F&& leaf) const
+	{
+		chunk_partitioner_.Execute(context, offset, count, std::forward<F>(leaf));
+	}
+private:
+	static uint64_t Now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// 心跳按线程计时,同一线程上的多个循环共享
+	static uint64_t& LastBeat()
+	{
+		thread_local uint64_t last_beat = 0;
+		return last_beat;
+	}
+
+	uint64_t heartbeat_ns_;
+	AutoPartitioner chunk_partitioner_;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// 当前线程的硬件性能计数器组,通过perf_event_open打开,只统计用户态
+// 内核禁止perf事件(perf_event_paranoid,容器的seccomp,虚拟机没有PMU)或非Linux平台时IsOpen返回false
+class PerfCounterGroup
+{
+public:
+	enum Counter
+	{
+		kCycles,
+		kInstructions,
+		kCacheMisses,
+		kBranchMisses,
+		kCounterCount,
+	};
+
+	struct Values
+	{
+		uint64_t values[kCounterCount] = {};
+	};
+
+	PerfCounterGroup()
+		: fds_{ -1, -1, -1, -1 }
+		, open_(false)
+	{
+	}
+
+	~PerfCounterGroup()
+	{
+		Close();
+	}
+
+	PerfCounterGroup(const PerfCounterGroup&) = delete;
+	PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+	// 当前线程第一次使用时打开,失败后不再重试
+	static PerfCounterGroup* GetThreadGroup()
+	{
+		thread_local PerfCounterGroup group;
+		thread_local bool tried = false;
+		if (!tried)
+		{
+			tried = true;
+			group.Open();
+		}
+		return group.IsOpen() ? &group : nullptr;
+	}
+
+	bool Open();
+	void Close();
+	bool IsOpen() const { return open_; }
+
+	// 读取整组计数器的当前值,一次系统调用
+	bool Read(Values& values) const;
+private:
+	int fds_[kCounterCount];
+	bool open_;
+};
+
+inline bool PerfCounterGroup::Open()
+{
+#ifdef __linux__
+	static const uint64_t kConfigs[kCounterCount] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	for (uint32_t i = 0; i < kCounterCount; ++i)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = kConfigs[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// 由组长统一开启
+		attr.disabled = i == 0 ? 1 : 0;
+
+		int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+		if (fd < 0)
+		{
+			Close();
+			return false;
+		}
+		fds_[i] = fd;
+	}
+
+	ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	open_ = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+inline void PerfCounterGroup::Close()
+{
+#ifdef __linux__
+	for (int& fd : fds_)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+#endif
+	open_ = false;
+}
+
+inline bool PerfCounterGroup::Read(Values& values) const
+{
+#ifdef __linux__
+	// PERF_FORMAT_GROUP的布局: nr, values[nr]
+	uint64_t buffer[1 + kCounterCount];
+	if (!open_ || read(fds_[0], buffer, sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer)) || buffer[0] != kCounterCount)
+	{
+		return false;
+	}
+
+	memcpy(values.values, buffer + 1, sizeof(values.values));
+	return true;
+#else
+	(void)values;
+	return false;
+#endif
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <map>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "job_system.hpp"
+
+enum class FilterMode
+{
+	kParallel,				// 可以并发处理多个数据
+	kSerialInOrder,			// 一次处理一个数据,按输入顺序
+	kSerialOutOfOrder,		// 一次处理一个数据,顺序不限
+};
+
+// TBB风格的流水线
+// 输入阶段串行读取数据,之后每个数据(令牌)在同一个作业里依次流过各个阶段,保持缓存局部性;
+// 串行阶段被占用或顺序未到时令牌暂存在该阶段,阶段空出后由离开的令牌以新作业的形式继续.
+// 同时在流水线中的令牌数量不超过max_tokens,内存占用有上限,阶段之间没有屏障
+template<class T>
+class Pipeline
+{
+public:
+	// 读取下一个数据,没有更多数据时返回false
+	using InputFunction = std::function<bool(T&)>;
+	using StageFunction = std::function<void(T&)>;
+
+	explicit Pipeline(JobSystem& job_system = JobSystem::Get())
+		: job_system_(job_system)
+		, input_done_(false)
+		, next_input_sequence_(0)
+	{
+	}
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	Pipeline& SetInput(InputFunction input)
+	{
+		input_ = std::move(input);
+		return *this;
+	}
+
+	Pipeline& AddStage(FilterMode mode, StageFunction function)
+	{
+		auto stage = std::make_unique<Stage>();
+		stage->mode = mode;
+		stage->function = std::move(function);
+		stages_.push_back(std::move(stage));
+		return *this;
+	}
+
+	// 运行直到输入结束,同时执行其他作业;某个阶段抛出异常时取消剩余处理并重新抛出
+	// 外层作业被取消时不再读取输入,已读入的令牌处理到当前阶段为止,Run正常返回
+	void Run(uint32_t max_tokens);
+private:
+	static constexpr uint32_t kInvalidToken = UINT32_MAX;
+
+	struct Token
+	{
+		T item;
+		uint64_t sequence;
+	};
+
+	struct Stage
+	{
+		FilterMode mode;
+		StageFunction function;
+
+		std::mutex mutex;
+		bool busy = false;
+		uint64_t next_sequence = 0;
+		// 等待进入本阶段的令牌
+		std::map<uint64_t, uint32_t> in_order_waiting;
+		std::deque<uint32_t> out_of_order_waiting;
+	};
+
+	bool ReadInput(uint32_t token);
+	void Process(Job* root, uint32_t token, size_t stage, bool owns_stage);
+	bool Enter(Stage& stage, uint32_t token);
+	void Leave(Job* root, size_t stage_index);
+
+	JobSystem& job_system_;
+	InputFunction input_;
+	std::vector<std::unique_ptr<Stage>> stages_;
+	std::vector<Token> tokens_;
+
+	std::mutex input_mutex_;
+	bool input_done_;
+	uint64_t next_input_sequence_;
+};
+
+template<class T>
+void Pipeline<T>::Run(uint32_t max_tokens)
+{
+	assert(input_ && max_tokens >= 1);
+
+	tokens_.clear();
+	tokens_.resize(max_tokens);
+	input_done_ = false;
+	next_input_sequence_ = 0;
+	for (auto& stage : stages_)
+	{
+		stage->busy = false;
+		stage->next_sequence = 0;
+		stage->in_order_waiting.clear();
+		stage->out_of_order_waiting.clear();
+	}
+
+	// 在作业中运行时继承当前作业的取消令牌,外层被取消时流水线一并停止
+	Job* current_job = job_system_.GetCurrentJob();
+	CancellationToken token(current_job ? current_job->cancellation : nullptr, true);
+	Job root;
+	job_system_.InitializeJob(&root, [this, max_tokens](Job* root)
+		{
+			for (uint32_t i = 0; i < max_tokens; ++i)
+			{
+				Job* job = job_system_.CreateJobAsChild(root, [this, root, i](Job*)
+					{
+						if (ReadInput(i))
+						{
+							Process(root, i, 0, false);
+						}
+					});
+				job_system_.Run(job);
+			}
+		});
+	job_system_.SetCancellationToken(&root, &token);
+
+	job_system_.Run(&root);
+	job_system_.Wait(&root);
+}
+
+template<class T>
+bool Pipeline<T>::ReadInput(uint32_t token)
+{
+	std::unique_lock lock(input_mutex_);
+	if (input_done_)
+	{
+		return false;
+	}
+
+	if (!input_(tokens_[token].item))
+	{
+		input_done_ = true;
+		return false;
+	}
+
+	tokens_[token].sequence = next_input_sequence_++;
+	return true;
+}
+
+template<class T>
+void Pipeline<T>::Process(Job* root, uint32_t token, size_t stage, bool owns_stage)
+{
+	for (;;)
+	{
+		for (; stage < stages_.size(); ++stage)
+		{
+			Stage& current = *stages_[stage];
+			if (current.mode == FilterMode::kParallel)
+			{
+				current.function(tokens_[token].item);
+				continue;
+			}
+
+			// 串行阶段被占用时令牌留在该阶段,由占用者离开时接着处理
+			if (!owns_stage && !Enter(current, token))
+			{
+				return;
+			}
+			owns_stage = false;
+
+			current.function(tokens_[token].item);
+			Leave(root, stage);
+		}
+
+		// 令牌流过所有阶段后立刻用来读取下一个数据
+		if (job_system_.IsCancelled(root) || !ReadInput(token))
+		{
+			return;
+		}
+		stage = 0;
+	}
+}
+
+template<class T>
+bool Pipeline<T>::Enter(Stage& stage, uint32_t token)
+{
+	std::unique_lock lock(stage.mutex);
+
+	bool in_order = stage.mode == FilterMode::kSerialInOrder;
+	if (!stage.busy && (!in_order || tokens_[token].sequence == stage.next_sequence))
+	{
+		stage.busy = true;
+		return true;
+	}
+
+	if (in_order)
+	{
+		stage.in_order_waiting.emplace(tokens_[token].sequence, token);
+	}
+	else
+	{
+		stage.out_of_order_waiting.push_back(token);
+	}
+	return false;
+}
+
+template<class T>
+void Pipeline<T>::Leave(Job* root, size_t stage_index)
+{
+	Stage& stage = *stages_[stage_index];
+
+	uint32_t next_token = kInvalidToken;
+	{
+		std::unique_lock lock(stage.mutex);
+
+		if (stage.mode == FilterMode::kSerialInOrder)
+		{
+			++stage.next_sequence;
+			auto it = stage.in_order_waiting.find(stage.next_sequence);
+			if (it != stage.in_order_waiting.end())
+			{
+				next_token = it->second;
+				stage.in_order_waiting.erase(it);
+			}
+		}
+		else if (!stage.out_of_order_waiting.empty())
+		{
+			next_token = stage.out_of_order_waiting.front();
+			stage.out_of_order_waiting.pop_front();
+		}
+
+		// 有令牌接手时阶段保持占用,直接移交
+		if (next_token == kInvalidToken)
+		{
+			stage.busy = false;
+		}
+	}
+
+	if (next_token != kInvalidToken)
+	{
+		Job* job = job_system_.CreateJobAsChild(root, [this, root, next_token, stage_index](Job*)
+			{
+				Process(root, next_token, stage_index, true);
+			});
+		job_system_.Run(job);
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+// 一个工作线程的调度统计快照
+struct WorkerStats
+{
+	uint64_t jobs_executed = 0;
+	uint64_t jobs_pushed = 0;
+	uint64_t local_pops = 0;
+	uint64_t steal_attempts = 0;
+	uint64_t steal_successes = 0;
+	uint64_t injection_pulls = 0;
+	uint64_t idle_spins = 0;
+	uint64_t parks = 0;
+	uint64_t wakeups = 0;
+	uint64_t max_deque_depth = 0;
+	uint64_t wait_time_ns = 0;
+
+	WorkerStats& operator+=(const WorkerStats& other)
+	{
+		jobs_executed += other.jobs_executed;
+		jobs_pushed += other.jobs_pushed;
+		local_pops += other.local_pops;
+		steal_attempts += other.steal_attempts;
+		steal_successes += other.steal_successes;
+		injection_pulls += other.injection_pulls;
+		idle_spins += other.idle_spins;
+		parks += other.parks;
+		wakeups += other.wakeups;
+		max_deque_depth = std::max(max_deque_depth, other.max_deque_depth);
+		wait_time_ns += other.wait_time_ns;
+		return *this;
+	}
+};
+
+// GetStats返回的快照
+// workers按工作线程索引排列,包括补偿工作线程;最后一项汇总了所有非工作线程(外部线程和阻塞线程池)
+struct SchedulerStats
+{
+	std::vector<WorkerStats> workers;
+	WorkerStats total;
+};
+
+// 工作线程私有的计数器,独占一条缓存行
+// 只有所属线程写入,用relaxed的读-写代替原子加法,编译出来就是普通的内存操作;读取快照时才汇总
+struct alignas(64) WorkerStatsCounters
+{
+	enum Counter
+	{
+		kJobsExecuted,
+		kJobsPushed,
+		kLocalPops,
+		kStealAttempts,
+		kStealSuccesses,
+		kInjectionPulls,
+		kIdleSpins,
+		kParks,
+		kWakeups,
+		kMaxDequeDepth,
+		kWaitTimeNs,
+		kCounterCount,
+	};
+
+	std::atomic_uint64_t values[kCounterCount] = {};
+
+	// shared为true时计数器由多个线程共享,需要真正的原子加法
+	void Add(Counter counter, uint64_t value, bool shared)
+	{
+		if (shared)
+		{
+			values[counter].fetch_add(value, std::memory_order_relaxed);
+		}
+		else
+		{
+			values[counter].store(values[counter].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+	}
+
+	// 只能由所属线程调用
+	void Max(Counter counter, uint64_t value)
+	{
+		if (values[counter].load(std::memory_order_relaxed) < value)
+		{
+			values[counter].store(value, std::memory_order_relaxed);
+		}
+	}
+
+	void Reset()
+	{
+		for (auto& value : values)
+		{
+			value.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	WorkerStats Snapshot() const
+	{
+		WorkerStats stats;
+		stats.jobs_executed = values[kJobsExecuted].load(std::memory_order_relaxed);
+		stats.jobs_pushed = values[kJobsPushed].load(std::memory_order_relaxed);
+		stats.local_pops = values[kLocalPops].load(std::memory_order_relaxed);
+		stats.steal_attempts = values[kStealAttempts].load(std::memory_order_relaxed);
+		stats.steal_successes = values[kStealSuccesses].load(std::memory_order_relaxed);
+		stats.injection_pulls = values[kInjectionPulls].load(std::memory_order_relaxed);
+		stats.idle_spins = values[kIdleSpins].load(std::memory_order_relaxed);
+		stats.parks = values[kParks].load(std::memory_order_relaxed);
+		stats.wakeups = values[kWakeups].load(std::memory_order_relaxed);
+		stats.max_deque_depth = values[kMaxDequeDepth].load(std::memory_order_relaxed);
+		stats.wait_time_ns = values[kWaitTimeNs].load(std::memory_order_relaxed);
+		return stats;
+	}
+};
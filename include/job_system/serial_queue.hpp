@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <utility>
+
+#include "mpsc_queue.hpp"
+
+// Strand和Actor共用的串行队列:无锁MPSC队列加上尚未处理的节点数量
+// Push使队列由空变为非空时返回true,调用方投递一个排空作业;同一时刻只有一个排空作业调用Drain,
+// 所以节点按FIFO顺序逐个处理,不会并发.Node必须继承MpscNode,由Push的调用方new出来,处理后由Drain删除
+template<class Node>
+class SerialQueue
+{
+public:
+	SerialQueue()
+		: size_(0)
+	{
+	}
+
+	SerialQueue(const SerialQueue&) = delete;
+	SerialQueue& operator=(const SerialQueue&) = delete;
+
+	// 可以在任意线程调用,返回true表示需要投递排空作业
+	bool Push(Node* node)
+	{
+		queue_.Push(node);
+		return size_.fetch_add(1, std::memory_order_acq_rel) == 0;
+	}
+
+	// 尚未处理完的节点数量
+	uint32_t GetSize() const { return size_.load(std::memory_order_relaxed); }
+
+	// 最多处理batch_size个节点,process(node)抛出的异常交给on_exception(node, exception)
+	// 返回true表示还有剩余,调用方需要重新投递排空作业让出工作线程;返回false时下一次Push会重新返回true
+	template<class F, class E>
+	bool Drain(uint32_t batch_size, F&& process, E&& on_exception)
+	{
+		for (uint32_t processed = 0; processed < batch_size; ++processed)
+		{
+			Node* node = queue_.Pop();
+			while (node == nullptr)
+			{
+				// size_已经计入但生产者还没链接完成
+				std::this_thread::yield();
+				node = queue_.Pop();
+			}
+
+			try
+			{
+				process(*node);
+			}
+			catch (...)
+			{
+				on_exception(*node, std::current_exception());
+			}
+			delete node;
+
+			if (size_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+private:
+	MpscQueue<Node> queue_;
+	std::atomic_uint32_t size_;
+};
+
+// 保留第一个没有被处理的异常,由Take取走
+class FirstException
+{
+public:
+	void Keep(std::exception_ptr exception)
+	{
+		std::unique_lock lock(mutex_);
+		if (!exception_)
+		{
+			exception_ = std::move(exception);
+		}
+	}
+
+	// 没有时返回空
+	std::exception_ptr Take()
+	{
+		std::unique_lock lock(mutex_);
+		std::exception_ptr exception = std::move(exception_);
+		exception_ = nullptr;
+		return exception;
+	}
+private:
+	std::mutex mutex_;
+	std::exception_ptr exception_;
+};
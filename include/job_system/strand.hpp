@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <functional>
+
+#include "job_system.hpp"
+#include "serial_queue.hpp"
+
+// 串行执行器:投递到同一个Strand的任务按FIFO顺序执行,且不会并发
+// 任务放在SerialQueue中,队列由空变为非空时投递一个排空作业,排空作业每次最多执行batch_size个任务,
+// 还有剩余时重新投递自己,让出工作线程保证公平
+// 排空作业没有父作业,任务的异常不会穿出Strand:交给Post时给的on_exception处理(仍在Strand上串行执行),
+// 没有给出或on_exception本身抛出时,Strand保留第一个异常,由TakeException取走
+class Strand
+{
+public:
+	static constexpr uint32_t kDefaultBatchSize = 64;
+
+	explicit Strand(JobSystem& job_system = JobSystem::Get(), uint32_t batch_size = kDefaultBatchSize)
+		: job_system_(job_system)
+		, batch_size_(batch_size)
+	{
+		assert(batch_size >= 1);
+	}
+
+	~Strand()
+	{
+		assert(queue_.GetSize() == 0);
+	}
+
+	Strand(const Strand&) = delete;
+	Strand& operator=(const Strand&) = delete;
+
+	using ExceptionHandler = std::function<void(std::exception_ptr)>;
+
+	void Post(std::function<void()> function, ExceptionHandler on_exception = nullptr)
+	{
+		auto task = new Task();
+		task->function = std::move(function);
+		task->on_exception = std::move(on_exception);
+		if (queue_.Push(task))
+		{
+			Schedule();
+		}
+	}
+
+	// 尚未执行完的任务数量
+	uint32_t GetSize() const { return queue_.GetSize(); }
+
+	// 取走第一个未处理的异常,没有时返回空
+	std::exception_ptr TakeException() { return exception_.Take(); }
+private:
+	struct Task : MpscNode
+	{
+		std::function<void()> function;
+		ExceptionHandler on_exception;
+	};
+
+	void Schedule()
+	{
+		job_system_.Run(job_system_.CreateJob([this](Job*)
+			{
+				Drain();
+			}));
+	}
+
+	void Drain()
+	{
+		bool remaining = queue_.Drain(batch_size_, [](Task& task)
+			{
+				task.function();
+			}, [this](Task& task, std::exception_ptr exception)
+			{
+				HandleException(task.on_exception, std::move(exception));
+			});
+
+		// 队列已空时下一次Post会重新投递排空作业
+		if (remaining)
+		{
+			Schedule();
+		}
+	}
+
+	void HandleException(const ExceptionHandler& on_exception, std::exception_ptr exception)
+	{
+		if (on_exception)
+		{
+			try
+			{
+				on_exception(exception);
+				return;
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+		}
+
+		exception_.Keep(std::move(exception));
+	}
+
+	JobSystem& job_system_;
+	const uint32_t batch_size_;
+	SerialQueue<Task> queue_;
+	FirstException exception_;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+#include "job_system.hpp"
+
+// 结构化的fork-join作业组
+// 前kInlineJobCount个子作业直接放在TaskGroup自身的存储上,不经过作业池.
+// 析构前一定会等待所有子作业完成,所以子作业的生命周期不会超出TaskGroup.
+// 在作业中创建的TaskGroup继承当前作业的取消令牌,外层被取消时组内作业一并跳过.
+// 组内的任务可以继续向同一个组Run新任务,Wait会等待它们全部完成
+class TaskGroup
+{
+public:
+	static constexpr uint32_t kInlineJobCount = 8;
+
+	explicit TaskGroup(JobSystem& job_system = JobSystem::Get());
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	template<class F>
+	void Run(F&& function);
+
+	// 等待所有子作业完成,同时执行其他作业;有子作业抛出异常时重新抛出第一个异常
+	void Wait();
+
+	// 尚未开始执行的子作业将被跳过,Wait之后自动复位
+	void Cancel() { token_.Cancel(); }
+	bool IsCancelled() const { return token_.IsCancelled(); }
+private:
+	void Reset();
+
+	JobSystem& job_system_;
+	Job root_;
+	Job jobs_[kInlineJobCount];
+	std::atomic_uint32_t job_count_;
+	CancellationToken token_;
+};
+
+inline TaskGroup::TaskGroup(JobSystem& job_system)
+	: job_system_(job_system)
+	, job_count_(0)
+	, token_(job_system.GetCurrentJob() ? job_system.GetCurrentJob()->cancellation : nullptr, true)
+{
+	Reset();
+}
+
+inline TaskGroup::~TaskGroup()
+{
+	if (job_count_ > 0)
+	{
+		try
+		{
+			Wait();
+		}
+		catch (...)
+		{
+			// 析构中不能抛出,未被Wait取走的异常直接丢弃
+		}
+	}
+}
+
+template<class F>
+void TaskGroup::Run(F&& function)
+{
+	// 子作业的异常由JobSystem收集到根作业上,第一个异常同时会取消令牌,跳过其余子作业
+	JobFunction wrapper = [function = std::forward<F>(function)](Job*) mutable
+	{
+		function();
+	};
+
+	// 组内任务也可能同时Run,内联槽位按原子计数分配
+	Job* job = nullptr;
+	uint32_t index = job_count_.fetch_add(1, std::memory_order_relaxed);
+	if (index < kInlineJobCount)
+	{
+		job = job_system_.InitializeJobAsChild(&root_, &jobs_[index], std::move(wrapper));
+	}
+	else
+	{
+		job = job_system_.CreateJobAsChild(&root_, std::move(wrapper));
+	}
+
+	job_system_.Run(job);
+}
+
+inline void TaskGroup::Wait()
+{
+	// 根作业自身的计数在这里结算
+	std::exception_ptr exception;
+	job_system_.Run(&root_);
+	try
+	{
+		job_system_.Wait(&root_);
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+	}
+
+	token_.Reset();
+	Reset();
+
+	if (exception)
+	{
+		std::rethrow_exception(exception);
+	}
+}
+
+inline void TaskGroup::Reset()
+{
+	job_count_ = 0;
+	job_system_.InitializeJob(&root_, [](Job*) {});
+	job_system_.SetCancellationToken(&root_, &token_);
+}
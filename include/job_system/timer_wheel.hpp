@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+
+#include "job.hpp"
+
+class CancellationToken;
+
+// 分层时间轮,精度1ms,共kLevelCount层,每层kSlotCount个槽
+// 任意线程都可以无锁地添加定时器(压入pending_栈),由空闲的工作线程推进时间轮并释放到期的定时器
+class TimerWheel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using Tick = std::chrono::milliseconds;
+
+	static constexpr uint32_t kSlotBits = 6;
+	static constexpr uint32_t kSlotCount = 1 << kSlotBits;
+	static constexpr uint64_t kSlotMask = kSlotCount - 1;
+	static constexpr uint32_t kLevelCount = 4;
+
+	struct Timer
+	{
+		uint64_t expire_tick;
+		uint64_t period_ticks;
+		Timer* next;
+		// 一次性定时器到期时投递job,周期定时器每次到期用function创建新作业
+		Job* job;
+		JobFunction function;
+		CancellationToken* token;
+	};
+
+	TimerWheel()
+		: start_(Clock::now())
+		, pending_(nullptr)
+		, timer_count_(0)
+		, current_tick_(0)
+		, inserted_count_(0)
+		, slots_{}
+	{
+	}
+
+	~TimerWheel()
+	{
+		Delete(pending_.exchange(nullptr));
+		for (auto& level : slots_)
+		{
+			for (Timer*& slot : level)
+			{
+				Delete(slot);
+				slot = nullptr;
+			}
+		}
+	}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	uint64_t ToTicks(Clock::duration duration) const
+	{
+		auto ticks = std::chrono::duration_cast<Tick>(duration + Tick(1) - Clock::duration(1)).count();
+		return ticks > 0 ? static_cast<uint64_t>(ticks) : 0;
+	}
+
+	uint64_t Now() const
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<Tick>(Clock::now() - start_).count());
+	}
+
+	// 添加定时器,可以在任意线程调用
+	void Add(Timer* timer)
+	{
+		timer_count_.fetch_add(1, std::memory_order_relaxed);
+
+		Timer* head = pending_.load(std::memory_order_relaxed);
+		do
+		{
+			timer->next = head;
+		} while (!pending_.compare_exchange_weak(head, timer, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// 推进时间轮到当前时间,对每个到期定时器调用on_expired(timer),返回true表示按周期重新挂入
+	// 同一时刻只有一个线程推进,其余线程直接返回0
+	template<class F>
+	uint32_t Advance(F&& on_expired)
+	{
+		return AdvanceTo(Now(), std::forward<F>(on_expired));
+	}
+
+	// 推进时间轮到指定的tick,不读时钟,用于测试逐层下放
+	template<class F>
+	uint32_t AdvanceTo(uint64_t now, F&& on_expired)
+	{
+		if (timer_count_.load(std::memory_order_relaxed) == 0)
+		{
+			return 0;
+		}
+
+		std::unique_lock lock(mutex_, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			return 0;
+		}
+
+		// 槽里没有定时器时不用逐个tick推进,直接跳到当前时间,空闲很久之后的第一个定时器不会让推进走完整段空闲时间
+		if (inserted_count_ == 0 && current_tick_ < now)
+		{
+			current_tick_ = now;
+		}
+
+		Timer* pending = pending_.exchange(nullptr, std::memory_order_acquire);
+		while (pending)
+		{
+			Timer* next = pending->next;
+			Insert(pending);
+			++inserted_count_;
+			pending = next;
+		}
+
+		uint32_t expired_count = 0;
+		while (current_tick_ <= now)
+		{
+			uint64_t tick = current_tick_;
+
+			// 低层转完一圈时,把高层对应槽里的定时器重新分散到低层
+			if ((tick & kSlotMask) == 0)
+			{
+				for (uint32_t level = 1; level < kLevelCount; ++level)
+				{
+					uint64_t index = (tick >> (level * kSlotBits)) & kSlotMask;
+					Timer* timer = slots_[level][index];
+					slots_[level][index] = nullptr;
+					while (timer)
+					{
+						Timer* next = timer->next;
+						Insert(timer);
+						timer = next;
+					}
+
+					if (index != 0)
+					{
+						break;
+					}
+				}
+			}
+
+			Timer* timer = slots_[0][tick & kSlotMask];
+			slots_[0][tick & kSlotMask] = nullptr;
+			while (timer)
+			{
+				Timer* next = timer->next;
+				++expired_count;
+				if (on_expired(timer))
+				{
+					timer->expire_tick = std::max(timer->expire_tick + timer->period_ticks, tick + 1);
+					Insert(timer);
+				}
+				else
+				{
+					delete timer;
+					--inserted_count_;
+					timer_count_.fetch_sub(1, std::memory_order_relaxed);
+				}
+				timer = next;
+			}
+
+			current_tick_ = tick + 1;
+
+			// 时间轮空了,直接跳到当前时间
+			if (inserted_count_ == 0)
+			{
+				current_tick_ = now + 1;
+			}
+		}
+
+		return expired_count;
+	}
+private:
+	void Insert(Timer* timer)
+	{
+		if (timer->expire_tick < current_tick_)
+		{
+			timer->expire_tick = current_tick_;
+		}
+
+		uint64_t delta = timer->expire_tick - current_tick_;
+		uint32_t level = 0;
+		while (level + 1 < kLevelCount && delta >= (uint64_t(1) << ((level + 1) * kSlotBits)))
+		{
+			++level;
+		}
+
+		// 超出最高层范围的定时器先挂在最高层最远的槽上,转到时再重新分散
+		uint64_t expire_tick = timer->expire_tick;
+		if (delta >= (uint64_t(1) << (kLevelCount * kSlotBits)))
+		{
+			expire_tick = current_tick_ + (uint64_t(1) << (kLevelCount * kSlotBits)) - 1;
+		}
+
+		Timer*& slot = slots_[level][(expire_tick >> (level * kSlotBits)) & kSlotMask];
+		timer->next = slot;
+		slot = timer;
+	}
+
+	static void Delete(Timer* timer)
+	{
+		while (timer)
+		{
+			Timer* next = timer->next;
+			delete timer;
+			timer = next;
+		}
+	}
+
+	const Clock::time_point start_;
+	std::atomic<Timer*> pending_;
+	std::atomic_uint32_t timer_count_;
+	std::mutex mutex_;
+	uint64_t current_tick_;
+	// 已经挂到槽里的定时器数量,不含pending_中的,由mutex_保护
+	uint32_t inserted_count_;
+	Timer* slots_[kLevelCount][kSlotCount];
+};
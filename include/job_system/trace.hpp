@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <ostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 调度器事件跟踪
+// 定义JOB_SYSTEM_ENABLE_TRACE时才编译埋点,否则JOB_SYSTEM_TRACE展开为空,没有任何开销;
+// 编译进来后还需要调用TraceRecorder::Enable才开始记录,未开启时每个埋点只多一次relaxed读
+#ifdef JOB_SYSTEM_ENABLE_TRACE
+#define JOB_SYSTEM_TRACE(type, id, worker_index) \
+	do \
+	{ \
+		if (TraceRecorder::IsEnabled()) \
+		{ \
+			TraceRecorder::Get().Record(TraceEventType::type, id, worker_index); \
+		} \
+	} while (false)
+#else
+#define JOB_SYSTEM_TRACE(type, id, worker_index) ((void)0)
+#endif
+
+enum class TraceEventType : uint32_t
+{
+	kJobBegin,
+	kJobEnd,
+	kEnqueue,
+	kStealSuccess,
+	kStealFail,
+	kIdleBegin,
+	kIdleEnd,
+	kParkBegin,
+	kParkEnd,
+	kWaitBegin,
+	kWaitEnd,
+};
+
+struct TraceEvent
+{
+	uint64_t timestamp;
+	const void* id;
+	TraceEventType type;
+};
+
+// 每个线程一个环形缓冲区,只有所属线程写入,写满后覆盖最旧的事件
+class TraceBuffer
+{
+public:
+	static constexpr uint32_t kCapacity = 1 << 16;
+	static_assert((kCapacity& (kCapacity - 1)) == 0, "!");
+
+	TraceBuffer()
+		: events_(new TraceEvent[kCapacity])
+		, write_index_(0)
+		, worker_index_(UINT32_MAX)
+		, idle_(false)
+	{
+	}
+
+	void Push(uint64_t timestamp, const void* id, TraceEventType type)
+	{
+		uint64_t index = write_index_.load(std::memory_order_relaxed);
+		events_[index & (kCapacity - 1)] = TraceEvent{ timestamp, id, type };
+		write_index_.store(index + 1, std::memory_order_release);
+	}
+
+	// 按时间顺序复制还没被覆盖的事件
+	std::vector<TraceEvent> Snapshot() const
+	{
+		uint64_t end = write_index_.load(std::memory_order_acquire);
+		uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+
+		std::vector<TraceEvent> events;
+		events.reserve(static_cast<size_t>(end - begin));
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			events.push_back(events_[i & (kCapacity - 1)]);
+		}
+		return events;
+	}
+
+	void Clear() { write_index_.store(0, std::memory_order_release); }
+
+	uint32_t GetWorkerIndex() const { return worker_index_.load(std::memory_order_relaxed); }
+	void SetWorkerIndex(uint32_t worker_index) { worker_index_.store(worker_index, std::memory_order_relaxed); }
+
+	// 空闲区间只在状态变化时记录,避免空转时刷满缓冲区
+	bool IsIdle() const { return idle_; }
+	void SetIdle(bool idle) { idle_ = idle; }
+private:
+	std::unique_ptr<TraceEvent[]> events_;
+	std::atomic_uint64_t write_index_;
+	std::atomic_uint32_t worker_index_;
+	bool idle_;
+};
+
+class TraceRecorder
+{
+public:
+	static TraceRecorder& Get()
+	{
+		static TraceRecorder recorder;
+		return recorder;
+	}
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	// 清空之前的事件并开始记录
+	void Enable();
+	void Disable() { enabled_.store(false, std::memory_order_relaxed); }
+	static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+	void Record(TraceEventType type, const void* id, uint32_t worker_index)
+	{
+		TraceBuffer* buffer = GetThreadBuffer();
+		buffer->SetWorkerIndex(worker_index);
+
+		// 空闲区间只在切换时记录,并且在开始执行作业,结束等待或挂起前关闭,保证区间正确嵌套;
+		// 空闲期间反复窃取失败不记录
+		if (type == TraceEventType::kStealFail && buffer->IsIdle())
+		{
+			return;
+		}
+
+		if (type == TraceEventType::kIdleBegin)
+		{
+			if (buffer->IsIdle())
+			{
+				return;
+			}
+			buffer->SetIdle(true);
+		}
+		else if (type == TraceEventType::kIdleEnd || type == TraceEventType::kJobBegin
+			|| type == TraceEventType::kWaitEnd || type == TraceEventType::kParkBegin)
+		{
+			if (buffer->IsIdle())
+			{
+				buffer->SetIdle(false);
+				buffer->Push(ReadTimestamp(), nullptr, TraceEventType::kIdleEnd);
+			}
+
+			if (type == TraceEventType::kIdleEnd)
+			{
+				return;
+			}
+		}
+
+		buffer->Push(ReadTimestamp(), id, type);
+	}
+
+	// 导出Chrome Trace Event格式(Perfetto也可以直接打开),最好在记录停止后调用
+	void ExportChromeTrace(std::ostream& stream) const;
+	bool ExportChromeTrace(const std::string& path) const;
+
+	static uint64_t ReadTimestamp()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+private:
+	using Clock = std::chrono::steady_clock;
+
+	TraceRecorder()
+		: start_timestamp_(0)
+	{
+	}
+
+	TraceBuffer* GetThreadBuffer()
+	{
+		thread_local TraceBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			// 缓冲区归记录器所有,线程退出后事件仍然可以导出
+			auto owned = std::make_unique<TraceBuffer>();
+			buffer = owned.get();
+			std::unique_lock lock(mutex_);
+			buffers_.push_back(std::move(owned));
+		}
+		return buffer;
+	}
+
+	// 静态成员,埋点检查开关时不需要经过单例的初始化检查
+	static inline std::atomic_bool enabled_{ false };
+	mutable std::mutex mutex_;
+	std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+	// 用于把时间戳换算成微秒
+	uint64_t start_timestamp_;
+	Clock::time_point start_time_;
+};
+
+inline void TraceRecorder::Enable()
+{
+	{
+		std::unique_lock lock(mutex_);
+		for (auto& buffer : buffers_)
+		{
+			buffer->Clear();
+		}
+	}
+
+	start_time_ = Clock::now();
+	start_timestamp_ = ReadTimestamp();
+	enabled_.store(true, std::memory_order_relaxed);
+}
+
+inline void TraceRecorder::ExportChromeTrace(std::ostream& stream) const
+{
+	// 用记录期间的墙上时间校准时间戳频率
+	double elapsed_us = std::chrono::duration<double, std::micro>(Clock::now() - start_time_).count();
+	uint64_t elapsed_ticks = ReadTimestamp() - start_timestamp_;
+	double ticks_per_us = elapsed_us > 0.0 && elapsed_ticks > 0 ? elapsed_ticks / elapsed_us : 1.0;
+
+	std::unique_lock lock(mutex_);
+
+	stream << "{\"traceEvents\":[";
+	bool first = true;
+	auto separator = [&first, &stream]()
+	{
+		if (!first)
+		{
+			stream << ",\n";
+		}
+		first = false;
+	};
+
+	for (size_t tid = 0; tid < buffers_.size(); ++tid)
+	{
+		const TraceBuffer& buffer = *buffers_[tid];
+		std::vector<TraceEvent> events = buffer.Snapshot();
+		if (events.empty())
+		{
+			continue;
+		}
+
+		uint32_t worker_index = buffer.GetWorkerIndex();
+		separator();
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+		if (worker_index == UINT32_MAX)
+		{
+			stream << "thread " << tid;
+		}
+		else
+		{
+			stream << "worker " << worker_index;
+		}
+		stream << "\"}}";
+
+		// 没有结束的区间(线程仍在空闲或执行中)在导出时补上结束事件;开始事件已被覆盖的结束事件丢弃,
+		// 保证每个线程的B/E成对出现
+		std::vector<const char*> open_names;
+		double last_ts = 0.0;
+
+		for (const TraceEvent& event : events)
+		{
+			const char* name = nullptr;
+			const char* phase = nullptr;
+			switch (event.type)
+			{
+			case TraceEventType::kJobBegin: name = "job"; phase = "B"; break;
+			case TraceEventType::kJobEnd: name = "job"; phase = "E"; break;
+			case TraceEventType::kEnqueue: name = "enqueue"; phase = "i"; break;
+			case TraceEventType::kStealSuccess: name = "steal"; phase = "i"; break;
+			case TraceEventType::kStealFail: name = "steal failed"; phase = "i"; break;
+			case TraceEventType::kIdleBegin: name = "idle"; phase = "B"; break;
+			case TraceEventType::kIdleEnd: name = "idle"; phase = "E"; break;
+			case TraceEventType::kParkBegin: name = "park"; phase = "B"; break;
+			case TraceEventType::kParkEnd: name = "park"; phase = "E"; break;
+			case TraceEventType::kWaitBegin: name = "wait"; phase = "B"; break;
+			case TraceEventType::kWaitEnd: name = "wait"; phase = "E"; break;
+			}
+
+			// 记录开始前的事件时间戳会回绕成很大的数,直接丢弃
+			if (event.timestamp < start_timestamp_)
+			{
+				continue;
+			}
+
+			if (phase[0] == 'B')
+			{
+				open_names.push_back(name);
+			}
+			else if (phase[0] == 'E')
+			{
+				if (open_names.empty())
+				{
+					continue;
+				}
+				open_names.pop_back();
+			}
+
+			char id[32];
+			snprintf(id, sizeof(id), "%p", event.id);
+
+			last_ts = std::max(last_ts, (event.timestamp - start_timestamp_) / ticks_per_us);
+			separator();
+			stream << "{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << tid
+				<< ",\"ts\":" << (event.timestamp - start_timestamp_) / ticks_per_us;
+			if (phase[0] == 'i')
+			{
+				stream << ",\"s\":\"t\"";
+			}
+			if (event.id)
+			{
+				stream << ",\"args\":{\"job\":\"" << id << "\"}";
+			}
+			stream << "}";
+		}
+
+		while (!open_names.empty())
+		{
+			separator();
+			stream << "{\"name\":\"" << open_names.back() << "\",\"ph\":\"E\",\"pid\":1,\"tid\":" << tid
+				<< ",\"ts\":" << std::max(last_ts, elapsed_us) << "}";
+			open_names.pop_back();
+		}
+	}
+
+	stream << "],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+inline bool TraceRecorder::ExportChromeTrace(const std::string& path) const
+{
+	std::ofstream stream(path);
+	if (!stream)
+	{
+		return false;
+	}
+
+	ExportChromeTrace(stream);
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "job.hpp"
+#include "job_category.hpp"
+
+// 作业图的work/span分析结果
+// work是所有作业独占执行时间之和,span是关键路径长度,parallelism = work / span;
+// P个工作线程的加速比估计:下界按Brent定理 work / (work / P + span),上界 min(P, parallelism)
+struct WorkSpanReport
+{
+	struct CriticalPathEntry
+	{
+		// 作业创建顺序的编号
+		uint32_t node = 0;
+		std::string category;
+		// 在关键路径上的执行时间;路径经过创建点时只算到创建点为止
+		uint64_t work_ns = 0;
+		// 在理想调度下最早开始的时间
+		uint64_t start_ns = 0;
+	};
+
+	uint64_t job_count = 0;
+	uint64_t work_ns = 0;
+	uint64_t span_ns = 0;
+	double parallelism = 0.0;
+	// 下标i对应i+1个工作线程
+	std::vector<double> speedup_lower;
+	std::vector<double> speedup_upper;
+	// 按时间顺序排列
+	std::vector<CriticalPathEntry> critical_path;
+};
+
+// Cilkview风格的分析器:JobSystem::SetWorkSpanAnalyzer挂接后,记录作业的创建,父子关系,后续作业和执行时间,
+// 运行结束后调用Analyze.所有记录都在一把锁下完成,只适合分析用,不要在正式运行中挂接
+// 依赖关系的建模:
+//  - 作业在另一个作业里创建时,最早在创建者执行到创建点时开始(创建者的独占时间偏移)
+//  - 作业完成 = 自身执行结束且所有子作业完成
+//  - 后续作业在前驱作业完成后才能开始
+// JobCounter和作业体内Wait造成的依赖不建模,Wait的时间不计入作业的work;非工作线程上两次提交之间的串行代码也不计入
+class WorkSpanAnalyzer
+{
+public:
+	enum class TimeSource
+	{
+		// 墙上时间,线程数超过核数时会把被抢占的时间算进作业
+		kWallClock,
+		// 线程CPU时间,不受抢占影响,但每次读取是一次系统调用,也不包括作业阻塞的时间
+		kThreadCpuTime,
+	};
+
+	explicit WorkSpanAnalyzer(TimeSource time_source = TimeSource::kWallClock)
+		: time_source_(time_source)
+		, read_cost_ns_(0)
+	{
+		// 估计一次读时钟的耗时,创建作业时扣除的开销要把两次读时钟本身也算上
+		constexpr uint32_t kSamples = 1000;
+		uint64_t begin_ns = Now();
+		for (uint32_t i = 0; i < kSamples; ++i)
+		{
+			Now();
+		}
+		read_cost_ns_ = (Now() - begin_ns) / kSamples;
+	}
+
+	WorkSpanAnalyzer(const WorkSpanAnalyzer&) = delete;
+	WorkSpanAnalyzer& operator=(const WorkSpanAnalyzer&) = delete;
+
+	void Clear()
+	{
+		std::unique_lock lock(mutex_);
+		nodes_.clear();
+		job_nodes_.clear();
+	}
+
+	WorkSpanReport Analyze(uint32_t max_workers, uint32_t max_critical_path_entries = 32) const;
+
+	// 以下由JobSystem调用
+	void OnCreate(Job* job);
+	void OnAttachChild(Job* parent, Job* job);
+	void OnContinuation(Job* ancestor, Job* continuation);
+	void OnExecuteBegin(Job* job);
+	void OnExecuteEnd(Job* job);
+	void OnWaitBegin();
+	void OnWaitEnd();
+private:
+	static constexpr uint32_t kNone = UINT32_MAX;
+
+	struct Node
+	{
+		uint32_t creator = kNone;
+		// 在创建者独占时间中的偏移
+		uint64_t offset_ns = 0;
+		uint32_t parent = kNone;
+		std::vector<uint32_t> predecessors;
+		uint64_t work_ns = 0;
+		uint32_t category = JobCategoryRegistry::kUnnamed;
+	};
+
+	// 当前线程上正在执行的作业
+	struct Frame
+	{
+		uint32_t node;
+		uint64_t begin_ns;
+		uint64_t nested_ns;
+		uint64_t wait_begin_ns;
+		uint64_t wait_nested_ns;
+	};
+
+	uint64_t Now() const
+	{
+		if (time_source_ == TimeSource::kThreadCpuTime)
+		{
+			return ReadThreadCpuTimeNs();
+		}
+
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	static std::vector<Frame>& Frames()
+	{
+		thread_local std::vector<Frame> frames;
+		return frames;
+	}
+
+	// 记录本身(读时钟,加锁,查表)的耗时不计入正在执行的作业
+	void ExcludeOverhead(uint64_t begin_ns) const
+	{
+		auto& frames = Frames();
+		if (!frames.empty())
+		{
+			frames.back().nested_ns += Now() - begin_ns + read_cost_ns_;
+		}
+	}
+
+	uint32_t FindNode(const Job* job) const
+	{
+		auto iter = job_nodes_.find(job);
+		return iter != job_nodes_.end() ? iter->second : kNone;
+	}
+
+	TimeSource time_source_;
+	uint64_t read_cost_ns_;
+	mutable std::mutex mutex_;
+	std::vector<Node> nodes_;
+	// 作业槽位会被作业池复用,映射总是指向最近一次创建的节点
+	std::unordered_map<const Job*, uint32_t> job_nodes_;
+};
+
+inline void WorkSpanAnalyzer::OnCreate(Job* job)
+{
+	uint64_t begin_ns = Now();
+
+	Node node;
+	auto& frames = Frames();
+	if (!frames.empty())
+	{
+		const Frame& frame = frames.back();
+		uint64_t elapsed_ns = begin_ns - frame.begin_ns;
+		node.creator = frame.node;
+		node.offset_ns = elapsed_ns > frame.nested_ns ? elapsed_ns - frame.nested_ns : 0;
+	}
+
+	{
+		std::unique_lock lock(mutex_);
+		job_nodes_[job] = static_cast<uint32_t>(nodes_.size());
+		nodes_.push_back(std::move(node));
+	}
+	ExcludeOverhead(begin_ns);
+}
+
+inline void WorkSpanAnalyzer::OnAttachChild(Job* parent, Job* job)
+{
+	std::unique_lock lock(mutex_);
+	uint32_t parent_node = FindNode(parent);
+	uint32_t node = FindNode(job);
+	if (parent_node != kNone && node != kNone)
+	{
+		nodes_[node].parent = parent_node;
+	}
+}
+
+inline void WorkSpanAnalyzer::OnContinuation(Job* ancestor, Job* continuation)
+{
+	std::unique_lock lock(mutex_);
+	uint32_t ancestor_node = FindNode(ancestor);
+	uint32_t node = FindNode(continuation);
+	if (ancestor_node != kNone && node != kNone)
+	{
+		nodes_[node].predecessors.push_back(ancestor_node);
+	}
+}
+
+inline void WorkSpanAnalyzer::OnExecuteBegin(Job* job)
+{
+	uint32_t node;
+	{
+		std::unique_lock lock(mutex_);
+		node = FindNode(job);
+		if (node == kNone)
+		{
+			// 挂接分析器之前创建的作业,当作没有依赖的根作业
+			node = static_cast<uint32_t>(nodes_.size());
+			job_nodes_[job] = node;
+			nodes_.emplace_back();
+		}
+	}
+
+	Frames().push_back(Frame{ node, Now(), 0, 0, 0 });
+}
+
+inline void WorkSpanAnalyzer::OnExecuteEnd(Job* job)
+{
+	auto& frames = Frames();
+	Frame frame = frames.back();
+	frames.pop_back();
+
+	// 扣除嵌套执行的其他作业,再把本作业的总时间计入外层
+	uint64_t elapsed_ns = Now() - frame.begin_ns;
+	uint64_t work_ns = elapsed_ns > frame.nested_ns ? elapsed_ns - frame.nested_ns : 0;
+	if (!frames.empty())
+	{
+		frames.back().nested_ns += elapsed_ns;
+	}
+
+	std::unique_lock lock(mutex_);
+	nodes_[frame.node].work_ns = work_ns;
+	nodes_[frame.node].category = job->category;
+}
+
+inline void WorkSpanAnalyzer::OnWaitBegin()
+{
+	auto& frames = Frames();
+	if (!frames.empty())
+	{
+		frames.back().wait_begin_ns = Now();
+		frames.back().wait_nested_ns = frames.back().nested_ns;
+	}
+}
+
+inline void WorkSpanAnalyzer::OnWaitEnd()
+{
+	// 整段等待都从作业的work中扣除,期间顺带执行的作业已经计入nested_ns,不能重复扣
+	auto& frames = Frames();
+	if (!frames.empty())
+	{
+		Frame& frame = frames.back();
+		frame.nested_ns = frame.wait_nested_ns + (Now() - frame.wait_begin_ns);
+	}
+}
+
+inline WorkSpanReport WorkSpanAnalyzer::Analyze(uint32_t max_workers, uint32_t max_critical_path_entries) const
+{
+	std::unique_lock lock(mutex_);
+
+	// 每个作业拆成开始和完成两个顶点,在DAG上求最长路径:
+	// 创建者开始 -(偏移)-> 开始, 前驱完成 -> 开始, 开始 -(work)-> 完成, 子作业完成 -> 父作业完成
+	uint32_t node_count = static_cast<uint32_t>(nodes_.size());
+	uint32_t vertex_count = node_count * 2;
+	auto start_vertex = [](uint32_t node) { return node * 2; };
+	auto finish_vertex = [](uint32_t node) { return node * 2 + 1; };
+
+	struct Edge
+	{
+		uint32_t to;
+		uint64_t weight;
+	};
+	std::vector<std::vector<Edge>> edges(vertex_count);
+	std::vector<uint32_t> in_degree(vertex_count, 0);
+	auto add_edge = [&](uint32_t from, uint32_t to, uint64_t weight)
+	{
+		edges[from].push_back(Edge{ to, weight });
+		++in_degree[to];
+	};
+
+	WorkSpanReport report;
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		const Node& node = nodes_[i];
+		report.work_ns += node.work_ns;
+
+		add_edge(start_vertex(i), finish_vertex(i), node.work_ns);
+		if (node.creator != kNone)
+		{
+			add_edge(start_vertex(node.creator), start_vertex(i), node.offset_ns);
+		}
+		if (node.parent != kNone)
+		{
+			add_edge(finish_vertex(i), finish_vertex(node.parent), 0);
+		}
+		for (uint32_t predecessor : node.predecessors)
+		{
+			add_edge(finish_vertex(predecessor), start_vertex(i), 0);
+		}
+	}
+	report.job_count = node_count;
+
+	// 拓扑序求最长路径,记录决定每个顶点的前驱
+	std::vector<uint64_t> distance(vertex_count, 0);
+	std::vector<uint32_t> from(vertex_count, kNone);
+	std::vector<uint32_t> ready;
+	for (uint32_t v = 0; v < vertex_count; ++v)
+	{
+		if (in_degree[v] == 0)
+		{
+			ready.push_back(v);
+		}
+	}
+
+	while (!ready.empty())
+	{
+		uint32_t v = ready.back();
+		ready.pop_back();
+		for (const Edge& edge : edges[v])
+		{
+			if (from[edge.to] == kNone || distance[v] + edge.weight > distance[edge.to])
+			{
+				distance[edge.to] = distance[v] + edge.weight;
+				from[edge.to] = v;
+			}
+			if (--in_degree[edge.to] == 0)
+			{
+				ready.push_back(edge.to);
+			}
+		}
+	}
+
+	uint32_t last = kNone;
+	for (uint32_t i = 0; i < node_count; ++i)
+	{
+		if (last == kNone || distance[finish_vertex(i)] > distance[last])
+		{
+			last = finish_vertex(i);
+		}
+	}
+
+	report.span_ns = last != kNone ? distance[last] : 0;
+	report.parallelism = report.span_ns ? static_cast<double>(report.work_ns) / report.span_ns : 0.0;
+	for (uint32_t workers = 1; workers <= max_workers; ++workers)
+	{
+		double time = static_cast<double>(report.work_ns) / workers + report.span_ns;
+		report.speedup_lower.push_back(time > 0.0 ? std::max(1.0, report.work_ns / time) : 1.0);
+		report.speedup_upper.push_back(report.span_ns ? std::min<double>(workers, report.parallelism) : workers);
+	}
+
+	// 沿前驱回溯:经过开始->完成的边说明整个作业在关键路径上,经过创建者开始->开始的边说明创建者到创建点为止的部分在关键路径上
+	for (uint32_t v = last; v != kNone && from[v] != kNone; v = from[v])
+	{
+		uint32_t node = v / 2;
+		uint32_t segment_node = kNone;
+		uint64_t segment_ns = 0;
+		if (v == finish_vertex(node) && from[v] == start_vertex(node))
+		{
+			segment_node = node;
+			segment_ns = nodes_[node].work_ns;
+		}
+		else if (v == start_vertex(node) && from[v] == start_vertex(nodes_[node].creator))
+		{
+			segment_node = nodes_[node].creator;
+			segment_ns = nodes_[node].offset_ns;
+		}
+
+		if (segment_node != kNone && segment_ns > 0)
+		{
+			WorkSpanReport::CriticalPathEntry entry;
+			entry.node = segment_node;
+			entry.category = JobCategoryRegistry::Get().GetName(nodes_[segment_node].category);
+			entry.work_ns = segment_ns;
+			entry.start_ns = distance[from[v]];
+			report.critical_path.push_back(std::move(entry));
+		}
+	}
+	std::reverse(report.critical_path.begin(), report.critical_path.end());
+
+	// 关键路径很长时只保留最耗时的若干项,仍按时间排序
+	if (report.critical_path.size() > max_critical_path_entries && max_critical_path_entries > 0)
+	{
+		auto entries = report.critical_path;
+		std::nth_element(entries.begin(), entries.begin() + (max_critical_path_entries - 1), entries.end(),
+			[](const auto& a, const auto& b) { return a.work_ns > b.work_ns; });
+		uint64_t threshold = entries[max_critical_path_entries - 1].work_ns;
+
+		std::vector<WorkSpanReport::CriticalPathEntry> kept;
+		for (auto& entry : report.critical_path)
+		{
+			if (entry.work_ns >= threshold && kept.size() < max_critical_path_entries)
+			{
+				kept.push_back(std::move(entry));
+			}
+		}
+		report.critical_path = std::move(kept);
+	}
+	return report;
+}
@@ -16,9 +16,16 @@ public:
 	{
 	}
 
-	//ܲ׼,Ӱ
+	//可能不准,但是无影响
 	bool IsEmpty() const { return top_ >= bottom_; }
 
+	//可能不准,只用于统计
+	size_t GetSize() const
+	{
+		auto size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+		return size > 0 ? static_cast<size_t>(size) : 0;
+	}
+
 	void Push(T job)
 	{
 		auto bottom = bottom_.load(std::memory_order_acquire);
@@ -32,7 +39,7 @@ public:
 		auto top = top_.load(std::memory_order_acquire);
 		if(bottom <= top)
 		{
-			// ָǰȥ
+			// 恢复提前减去的
 			bottom_.store(bottom, std::memory_order_release);
 			return nullptr;
 		}
@@ -40,21 +47,21 @@ public:
 		auto job = jobs_[--bottom & kMask];
 		if (top != bottom)
 		{
-			//жjob,ֱӷ
-			//Steal()в(steal()ᱻ̲߳)
+			//队列中有多个job,可以直接返回
+			//不会跟Steal()中有并发竞争(steal()不会被多个线程并发)
 			return job;
 		}
 
-		// б߳ȡ
+		// 工作队列被其他并发线程窃取
 		if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_release))
 		{
-			//CAS ɹˣӮSteal()ı
-			//£bottom = top + 1˫˶Ϊ淶Ŀ״̬
+			//CAS 成功了，我们赢得了与Steal()的比赛。
+			//在这种情况下，我们设置bottom = top + 1将双端队列设置为规范的空状态。
 
-			//CAS ʧˣSteal()ı
-			//£Ƿһҵbottom = top + 1
-			//ΪʲôΪζŲSteal()ɹtop = top + 1
-			//Ȼ뽫˫˶Ϊ״̬
+			//CAS 失败了，我们输掉了与Steal()的比赛。
+			//在这种情况下，我们返回一个空作业，但仍设置bottom = top + 1。
+			//为什么？因为输掉比赛意味着并发的Steal()操作成功设置了top = top + 1，
+			//所以我们仍然必须将双端队列设置为空状态。
 			job = nullptr;
 		}
 
@@ -74,7 +81,7 @@ public:
 
 		auto job = jobs_[top & kMask];
 
-		// б߳ȡ
+		// 工作队列被其他并发线程窃取
 		if(!top_.compare_exchange_strong(top,top + 1,std::memory_order_release))
 		{
 			return nullptr;
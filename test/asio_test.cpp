@@ -5,6 +5,8 @@
 #include "timer.hpp"
 #include <cstdlib>
 
+#include "../include/job_system/asio_executor.hpp"
+
 
 class ThreadPool {
 public:
@@ -92,6 +94,37 @@ int main()
 		pool.reset();
 	}
 
+	// 同样的工作通过JobSystem执行器投递
+	{
+		auto& job_system = JobSystem::Get();
+		job_system.Start(std::thread::hardware_concurrency());
+
+		JobExecutionContext context(job_system);
+		JobCounter counter;
+		JobExecutor executor(context, &counter);
+		Timer t("job executor time");
+
+		for (size_t i = 0; i < vec.size() / 256; ++i)
+		{
+			float* data = vec.data() + i * 256;
+			uint32_t count = 256;
+			asio::post(executor, [data, count]()
+			{
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					for (int j = 0; j < 2000; ++j)
+					{
+						*(data + i) = sqrt((sqrt(*(data + i)) * sqrt(*(data + i)))) * sqrt((sqrt(*(data + i)) * sqrt(*(data + i))));
+						*(data + i) = sqrt((sqrt(*(data + i)) * sqrt(*(data + i)))) * sqrt((sqrt(*(data + i)) * sqrt(*(data + i))));
+					}
+				}
+			});
+		}
+
+		job_system.Wait(&counter);
+		job_system.Stop();
+	}
+
 	system("pause");
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,655 @@
+#include "../3rdparty/asio-1.16.1/include/asio.hpp"
+
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "../include/job_system/job_system.hpp"
+
+// 基准测试套件:每个用例在1..N个工作线程下重复运行,报告中位数和MAD(中位数绝对偏差)
+// 用法: Benchmark [--workers N] [--repetitions R] [--filter name] [--csv path] [--json path] [--analyze P]
+// --analyze P: 不计时,每个用例用N个工作线程运行一次并做work/span分析,输出1..P个工作线程的预测加速比
+
+using Clock = std::chrono::steady_clock;
+
+struct Benchmark
+{
+	std::string name;
+	std::string unit;
+	uint32_t min_workers;
+	// 不使用JobSystem的对照用例,运行时先停止JobSystem,避免空转的工作线程抢占CPU
+	bool baseline;
+	// 运行一次,返回测得的值(单位为unit)
+	std::function<double(JobSystem&, uint32_t workers)> run;
+};
+
+struct Result
+{
+	std::string name;
+	std::string unit;
+	uint32_t workers;
+	double median;
+	double mad;
+};
+
+double ElapsedUs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+double MedianAbsoluteDeviation(const std::vector<double>& values, double median)
+{
+	std::vector<double> deviations;
+	for (double value : values)
+	{
+		deviations.push_back(std::abs(value - median));
+	}
+	return Median(deviations);
+}
+
+void Spin(float* data, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		for (int j = 0; j < 50; ++j)
+		{
+			data[i] = std::sqrt(data[i] * data[i] + 1.0f);
+		}
+	}
+}
+
+// 矩阵转置:按行分割时写入端跨行访问,按二维分块时读写都落在缓存内
+constexpr uint32_t kMatrixSize = 1024;
+
+double RunTransposeRows(JobSystem& job_system, std::vector<float>& in, std::vector<float>& out)
+{
+	std::vector<float*> rows;
+	for (uint32_t i = 0; i < kMatrixSize; ++i)
+	{
+		rows.push_back(in.data() + i * kMatrixSize);
+	}
+
+	auto start = Clock::now();
+	float* first_row = in.data();
+	float* target = out.data();
+	Job* job = job_system.ParallelFor<float*, uint32_t>(rows.data(), kMatrixSize, [first_row, target](float** row, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint32_t r = static_cast<uint32_t>((row[i] - first_row) / kMatrixSize);
+				for (uint32_t c = 0; c < kMatrixSize; ++c)
+				{
+					target[c * kMatrixSize + r] = row[i][c];
+				}
+			}
+		}, 8);
+	job_system.Run(job);
+	job_system.Wait(job);
+	return ElapsedUs(start);
+}
+
+double RunTransposeTiles(JobSystem& job_system, std::vector<float>& in, std::vector<float>& out)
+{
+	auto start = Clock::now();
+	float* target = out.data();
+	Job* job = job_system.ParallelFor2D<float>(in.data(), kMatrixSize, kMatrixSize, kMatrixSize * sizeof(float), [target](const Tile2D<float>& tile)
+		{
+			for (uint32_t r = 0; r < tile.rows; ++r)
+			{
+				const float* row = tile.Row(r);
+				for (uint32_t c = 0; c < tile.cols; ++c)
+				{
+					target[(tile.col_begin + c) * kMatrixSize + tile.row_begin + r] = row[c];
+				}
+			}
+		});
+	job_system.Run(job);
+	job_system.Wait(job);
+	return ElapsedUs(start);
+}
+
+// fork-join
+uint64_t Fib(JobSystem& job_system, uint32_t n)
+{
+	if (n < 16)
+	{
+		uint64_t a = 0, b = 1;
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			uint64_t t = a + b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+
+	uint64_t x = 0;
+	Job* job = job_system.CreateJob([&job_system, &x, n](Job*)
+		{
+			x = Fib(job_system, n - 1);
+		});
+	job_system.Run(job);
+	uint64_t y = Fib(job_system, n - 2);
+	job_system.Wait(job);
+	return x + y;
+}
+
+uint32_t SolveQueens(uint32_t n, uint32_t row, uint32_t columns, uint32_t left, uint32_t right)
+{
+	if (row == n)
+	{
+		return 1;
+	}
+
+	uint32_t count = 0;
+	uint32_t free = ~(columns | left | right) & ((1u << n) - 1);
+	while (free)
+	{
+		uint32_t bit = free & (0 - free);
+		free ^= bit;
+		count += SolveQueens(n, row + 1, columns | bit, (left | bit) << 1, (right | bit) >> 1);
+	}
+	return count;
+}
+
+// 前两行并行展开,之后串行求解
+uint32_t ParallelQueens(JobSystem& job_system, uint32_t n, uint32_t row, uint32_t columns, uint32_t left, uint32_t right)
+{
+	if (row == 2)
+	{
+		return SolveQueens(n, row, columns, left, right);
+	}
+
+	std::atomic_uint32_t count = 0;
+	Job root;
+	job_system.InitializeJob(&root, [&](Job* root)
+		{
+			uint32_t free = ~(columns | left | right) & ((1u << n) - 1);
+			while (free)
+			{
+				uint32_t bit = free & (0 - free);
+				free ^= bit;
+				job_system.Run(job_system.CreateJobAsChild(root, [&, bit](Job*)
+					{
+						count += ParallelQueens(job_system, n, row + 1, columns | bit, (left | bit) << 1, (right | bit) >> 1);
+					}));
+			}
+		});
+	job_system.Run(&root);
+	job_system.Wait(&root);
+	return count;
+}
+
+template<class S>
+double RunParallelFor(JobSystem& job_system, std::vector<float>& data, const S& splitter)
+{
+	auto start = Clock::now();
+	Job* job = job_system.ParallelFor<float, S>(data.data(), static_cast<uint32_t>(data.size()), Spin, splitter);
+	job_system.Run(job);
+	job_system.Wait(job);
+	return ElapsedUs(start);
+}
+
+double RunNestedParallelFor(JobSystem& job_system, std::vector<float>& data)
+{
+	constexpr uint32_t kRows = 64;
+	uint32_t row_size = static_cast<uint32_t>(data.size()) / kRows;
+	std::vector<float*> rows;
+	for (uint32_t i = 0; i < kRows; ++i)
+	{
+		rows.push_back(data.data() + i * row_size);
+	}
+
+	auto start = Clock::now();
+	Job* job = job_system.ParallelFor<float*, uint32_t>(rows.data(), kRows, [&job_system, row_size](float** row, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Job* inner = job_system.ParallelFor<float, uint32_t>(row[i], row_size, Spin, 256);
+				job_system.Run(inner);
+				job_system.Wait(inner);
+			}
+		}, 1);
+	job_system.Run(job);
+	job_system.Wait(job);
+	return ElapsedUs(start);
+}
+
+// 宽DAG:每个子作业带一个后续作业,全部挂在同一个根作业下
+double RunWideDag(JobSystem& job_system)
+{
+	constexpr uint32_t kWidth = 4096;
+	std::atomic_uint32_t sum = 0;
+
+	auto start = Clock::now();
+	Job root;
+	job_system.InitializeJob(&root, [&job_system, &sum](Job* root)
+		{
+			for (uint32_t i = 0; i < kWidth; ++i)
+			{
+				Job* continuation = job_system.CreateJobAsChild(root, [&sum](Job*) { sum.fetch_add(1, std::memory_order_relaxed); });
+				Job* job = job_system.CreateJobAsChild(root, [](Job*) {});
+				job_system.AddContinuation(job, continuation);
+				job_system.Run(job);
+			}
+		});
+	job_system.Run(&root);
+	job_system.Wait(&root);
+	return ElapsedUs(start);
+}
+
+// 深DAG:后续作业串成一条长链
+double RunDeepDag(JobSystem& job_system)
+{
+	constexpr uint32_t kDepth = 4096;
+	std::vector<Job> chain(kDepth);
+	uint32_t sum = 0;
+
+	auto start = Clock::now();
+	Job root;
+	job_system.InitializeJob(&root, [](Job*) {});
+	for (uint32_t i = 0; i < kDepth; ++i)
+	{
+		job_system.InitializeJobAsChild(&root, &chain[i], [&sum](Job*) { ++sum; });
+	}
+	for (uint32_t i = 0; i + 1 < kDepth; ++i)
+	{
+		job_system.AddContinuation(&chain[i], &chain[i + 1]);
+	}
+	job_system.Run(&chain[0]);
+	job_system.Run(&root);
+	job_system.Wait(&root);
+	return ElapsedUs(start);
+}
+
+// 空作业的调度开销,每批作业数量小于作业池容量
+double RunEmptyJobs(JobSystem& job_system)
+{
+	constexpr uint32_t kBatchCount = 10;
+	constexpr uint32_t kBatchSize = 10000;
+
+	auto start = Clock::now();
+	for (uint32_t batch = 0; batch < kBatchCount; ++batch)
+	{
+		Job root;
+		job_system.InitializeJob(&root, [&job_system](Job* root)
+			{
+				for (uint32_t i = 0; i < kBatchSize; ++i)
+				{
+					job_system.Run(job_system.CreateJobAsChild(root, [](Job*) {}));
+				}
+			});
+		job_system.Run(&root);
+		job_system.Wait(&root);
+	}
+	return ElapsedUs(start) * 1000.0 / (kBatchCount * kBatchSize);
+}
+
+// 从外部线程投递到工作线程开始执行的延迟
+double RunSpawnLatency(JobSystem& job_system)
+{
+	constexpr uint32_t kSamples = 1000;
+	std::atomic<double> total_ns = 0;
+
+	// 主线程等待根作业期间执行注入的作业,外部线程全部投递完后放行gate
+	Job root;
+	Job gate;
+	job_system.InitializeJob(&root, [](Job*) {});
+	job_system.InitializeJobAsChild(&root, &gate, [](Job*) {});
+
+	std::thread submitter([&job_system, &total_ns, &gate]()
+		{
+			for (uint32_t i = 0; i < kSamples; ++i)
+			{
+				std::atomic_bool started = false;
+				auto submitted = Clock::now();
+				job_system.Run(job_system.CreateJob([&total_ns, &started, submitted](Job*)
+					{
+						total_ns = total_ns + std::chrono::duration<double, std::nano>(Clock::now() - submitted).count();
+						started = true;
+					}));
+				while (!started)
+				{
+					std::this_thread::yield();
+				}
+			}
+			job_system.Run(&gate);
+		});
+
+	job_system.Run(&root);
+	job_system.Wait(&root);
+	submitter.join();
+	return total_ns / kSamples;
+}
+
+// 作业压入本线程队列后被其他工作线程窃取的延迟
+double RunStealLatency(JobSystem& job_system)
+{
+	constexpr uint32_t kSamples = 1000;
+	double total_ns = 0;
+
+	for (uint32_t i = 0; i < kSamples; ++i)
+	{
+		std::atomic<int64_t> started_ns = 0;
+		auto pushed = Clock::now();
+		Job* job = job_system.CreateJob([&started_ns, pushed](Job*)
+			{
+				started_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - pushed).count() + 1;
+			});
+		job_system.Run(job);
+
+		// 不从自己的队列取作业,只等其他线程窃取
+		while (started_ns == 0)
+		{
+			std::this_thread::yield();
+		}
+		total_ns += static_cast<double>(started_ns - 1);
+		job_system.Wait(job);
+	}
+	return total_ns / kSamples;
+}
+
+// 同样的分块负载交给asio线程池执行,作为对照
+double RunAsioPool(uint32_t workers, std::vector<float>& data)
+{
+	constexpr uint32_t kChunk = 256;
+
+	auto start = Clock::now();
+	asio::io_context io_context;
+	for (size_t offset = 0; offset < data.size(); offset += kChunk)
+	{
+		float* chunk = data.data() + offset;
+		uint32_t count = static_cast<uint32_t>(std::min<size_t>(kChunk, data.size() - offset));
+		asio::post(io_context, [chunk, count]()
+			{
+				Spin(chunk, count);
+			});
+	}
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < workers; ++i)
+	{
+		threads.emplace_back([&io_context]()
+			{
+				io_context.run();
+			});
+	}
+	io_context.run();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	return ElapsedUs(start);
+}
+
+std::vector<Benchmark> CreateBenchmarks(std::vector<float>& data)
+{
+	std::vector<Benchmark> benchmarks;
+
+	benchmarks.push_back({ "fib_30", "us", 1, false, [](JobSystem& job_system, uint32_t)
+		{
+			auto start = Clock::now();
+			Fib(job_system, 30);
+			return ElapsedUs(start);
+		} });
+
+	benchmarks.push_back({ "nqueens_10", "us", 1, false, [](JobSystem& job_system, uint32_t)
+		{
+			auto start = Clock::now();
+			ParallelQueens(job_system, 10, 0, 0, 0, 0);
+			return ElapsedUs(start);
+		} });
+
+	for (uint32_t grain : { 64u, 1024u, 16384u })
+	{
+		benchmarks.push_back({ "parallel_for_grain_" + std::to_string(grain), "us", 1, false, [&data, grain](JobSystem& job_system, uint32_t)
+			{
+				return RunParallelFor(job_system, data, grain);
+			} });
+	}
+
+	benchmarks.push_back({ "parallel_for_static", "us", 1, false, [&data](JobSystem& job_system, uint32_t)
+		{
+			return RunParallelFor(job_system, data, StaticPartitioner());
+		} });
+
+	// 分割器在各次运行之间共享,测得的元素耗时可以复用
+	AutoPartitioner auto_partitioner;
+	benchmarks.push_back({ "parallel_for_auto", "us", 1, false, [&data, auto_partitioner](JobSystem& job_system, uint32_t)
+		{
+			return RunParallelFor(job_system, data, auto_partitioner);
+		} });
+
+	HeartbeatPartitioner heartbeat_partitioner;
+	benchmarks.push_back({ "parallel_for_heartbeat", "us", 1, false, [&data, heartbeat_partitioner](JobSystem& job_system, uint32_t)
+		{
+			return RunParallelFor(job_system, data, heartbeat_partitioner);
+		} });
+
+	// 每次运行遍历同一个数组,从第二次起每块回到上次执行它的工作线程
+	AffinityPartitioner affinity_partitioner;
+	benchmarks.push_back({ "parallel_for_affinity", "us", 1, false, [&data, affinity_partitioner](JobSystem& job_system, uint32_t)
+		{
+			return RunParallelFor(job_system, data, affinity_partitioner);
+		} });
+
+	benchmarks.push_back({ "parallel_for_nested", "us", 1, false, [&data](JobSystem& job_system, uint32_t)
+		{
+			return RunNestedParallelFor(job_system, data);
+		} });
+
+	auto matrix_in = std::make_shared<std::vector<float>>(kMatrixSize * kMatrixSize, 1.0f);
+	auto matrix_out = std::make_shared<std::vector<float>>(kMatrixSize * kMatrixSize, 0.0f);
+	benchmarks.push_back({ "transpose_rows", "us", 1, false, [matrix_in, matrix_out](JobSystem& job_system, uint32_t)
+		{
+			return RunTransposeRows(job_system, *matrix_in, *matrix_out);
+		} });
+	benchmarks.push_back({ "transpose_tiles_2d", "us", 1, false, [matrix_in, matrix_out](JobSystem& job_system, uint32_t)
+		{
+			return RunTransposeTiles(job_system, *matrix_in, *matrix_out);
+		} });
+
+	benchmarks.push_back({ "dag_wide", "us", 1, false, [](JobSystem& job_system, uint32_t) { return RunWideDag(job_system); } });
+	benchmarks.push_back({ "dag_deep", "us", 1, false, [](JobSystem& job_system, uint32_t) { return RunDeepDag(job_system); } });
+	benchmarks.push_back({ "empty_job", "ns/job", 1, false, [](JobSystem& job_system, uint32_t) { return RunEmptyJobs(job_system); } });
+	benchmarks.push_back({ "spawn_latency", "ns", 1, false, [](JobSystem& job_system, uint32_t) { return RunSpawnLatency(job_system); } });
+	benchmarks.push_back({ "steal_latency", "ns", 2, false, [](JobSystem& job_system, uint32_t) { return RunStealLatency(job_system); } });
+
+	benchmarks.push_back({ "asio_pool", "us", 1, true, [&data](JobSystem&, uint32_t workers)
+		{
+			return RunAsioPool(workers, data);
+		} });
+	benchmarks.push_back({ "job_system_chunks", "us", 1, false, [&data](JobSystem& job_system, uint32_t)
+		{
+			return RunParallelFor(job_system, data, 256);
+		} });
+
+	return benchmarks;
+}
+
+void WriteCsv(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream stream(path);
+	stream << "benchmark,workers,median,mad,unit\n";
+	for (auto& result : results)
+	{
+		stream << result.name << "," << result.workers << "," << result.median << "," << result.mad << "," << result.unit << "\n";
+	}
+}
+
+void WriteJson(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream stream(path);
+	stream << "[\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		auto& result = results[i];
+		stream << "  {\"benchmark\":\"" << result.name << "\",\"workers\":" << result.workers
+			<< ",\"median\":" << result.median << ",\"mad\":" << result.mad << ",\"unit\":\"" << result.unit << "\"}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	stream << "]\n";
+}
+
+void Analyze(std::vector<Benchmark>& benchmarks, uint32_t workers, uint32_t max_workers, const std::string& filter)
+{
+	auto& job_system = JobSystem::Get();
+	job_system.Start(workers);
+
+	for (auto& benchmark : benchmarks)
+	{
+		if (benchmark.baseline || workers < benchmark.min_workers || benchmark.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		// 线程数可能超过核数,用线程CPU时间避免把被抢占的时间算进作业
+		WorkSpanAnalyzer analyzer(WorkSpanAnalyzer::TimeSource::kThreadCpuTime);
+		job_system.SetWorkSpanAnalyzer(&analyzer);
+		benchmark.run(job_system, workers);
+		job_system.SetWorkSpanAnalyzer(nullptr);
+
+		WorkSpanReport report = analyzer.Analyze(max_workers, 5);
+		std::cout << benchmark.name << " jobs=" << report.job_count << " work=" << report.work_ns / 1000.0 << "us span="
+			<< report.span_ns / 1000.0 << "us parallelism=" << report.parallelism << std::endl;
+
+		std::cout << "  speedup";
+		for (uint32_t p = 1; p <= max_workers; p *= 2)
+		{
+			std::cout << " P" << p << "=" << report.speedup_lower[p - 1] << "~" << report.speedup_upper[p - 1];
+		}
+		std::cout << std::endl;
+
+		std::cout << "  critical path";
+		for (auto& entry : report.critical_path)
+		{
+			std::cout << " [job " << entry.node << " " << entry.category << " " << entry.work_ns / 1000.0 << "us]";
+		}
+		std::cout << std::endl;
+	}
+
+	job_system.Stop();
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t max_workers = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t repetitions = 10;
+	std::string filter;
+	std::string csv_path;
+	std::string json_path;
+	uint32_t analyze_workers = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--workers") == 0)
+		{
+			max_workers = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--repetitions") == 0)
+		{
+			repetitions = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--filter") == 0)
+		{
+			filter = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--csv") == 0)
+		{
+			csv_path = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--json") == 0)
+		{
+			json_path = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "--analyze") == 0)
+		{
+			analyze_workers = std::max(1, atoi(argv[i + 1]));
+		}
+	}
+
+	std::vector<float> data(1 << 16, 10.0f);
+	std::vector<Benchmark> benchmarks = CreateBenchmarks(data);
+
+	if (analyze_workers)
+	{
+		Analyze(benchmarks, max_workers, analyze_workers, filter);
+		return 0;
+	}
+
+	// 工作线程数量按1,2,4...递增,最后一定包含max_workers
+	std::vector<uint32_t> worker_counts;
+	for (uint32_t workers = 1; workers < max_workers; workers *= 2)
+	{
+		worker_counts.push_back(workers);
+	}
+	worker_counts.push_back(max_workers);
+
+	auto& job_system = JobSystem::Get();
+	std::vector<Result> results;
+	for (uint32_t workers : worker_counts)
+	{
+		for (bool baseline : { false, true })
+		{
+			if (!baseline)
+			{
+				job_system.Start(workers);
+			}
+
+			for (auto& benchmark : benchmarks)
+			{
+				if (benchmark.baseline != baseline || workers < benchmark.min_workers
+					|| benchmark.name.find(filter) == std::string::npos)
+				{
+					continue;
+				}
+
+				// 预热一次
+				benchmark.run(job_system, workers);
+
+				std::vector<double> samples;
+				for (uint32_t i = 0; i < repetitions; ++i)
+				{
+					samples.push_back(benchmark.run(job_system, workers));
+				}
+
+				double median = Median(samples);
+				Result result{ benchmark.name, benchmark.unit, workers, median, MedianAbsoluteDeviation(samples, median) };
+				results.push_back(result);
+
+				std::cout << benchmark.name << " workers=" << workers << " median=" << result.median << benchmark.unit
+					<< " mad=" << result.mad << benchmark.unit << std::endl;
+			}
+
+			if (!baseline)
+			{
+				job_system.Stop();
+			}
+		}
+	}
+
+	if (!csv_path.empty())
+	{
+		WriteCsv(csv_path, results);
+	}
+	if (!json_path.empty())
+	{
+		WriteJson(json_path, results);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <string>
+
+#include "../include/job_system/job_system.hpp"
+#include "timer.hpp"
+
+// 每个派发作业创建的叶子作业数量,派发作业被窃取后分散在不同工作线程上同时向同一个父作业提交子作业
+constexpr uint32_t kChildrenPerSpawner = 1024;
+
+// 先提交下一个派发作业再提交叶子,保证每个线程上未完成的作业不会超出作业池容量
+void Spawn(JobSystem& job_system, Job* root, std::atomic_uint32_t& sum, uint32_t remaining)
+{
+	uint32_t count = std::min(kChildrenPerSpawner, remaining);
+	if (remaining > count)
+	{
+		Job* next = job_system.CreateJobAsChild(root, [&job_system, root, &sum, remaining, count](Job*)
+			{
+				Spawn(job_system, root, sum, remaining - count);
+			});
+		job_system.Run(next);
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Job* child = job_system.CreateJobAsChild(root, [](Job*) {});
+		job_system.Run(child);
+	}
+	sum.fetch_add(count, std::memory_order_relaxed);
+}
+
+void RunFanIn(JobSystem& job_system, uint32_t children, FanInCounter* counter)
+{
+	std::atomic_uint32_t sum = 0;
+
+	// 根作业要存活到所有子作业完成,子作业数量超过作业池容量,所以不能从作业池分配
+	Job storage;
+	auto root = job_system.InitializeJob(&storage, [&job_system, &sum, children](Job* root)
+		{
+			Spawn(job_system, root, sum, children);
+		});
+
+	if (counter)
+	{
+		job_system.SetFanInCounter(root, counter);
+	}
+
+	Timer t((counter ? "fan-in   " : "flat     ") + std::to_string(children) + " children: ");
+	job_system.Run(root);
+	job_system.Wait(root);
+
+	assert(sum == children);
+}
+
+int main()
+{
+	auto& job_system = JobSystem::Get();
+	job_system.Start(std::thread::hardware_concurrency());
+	std::cout << "begin" << std::endl;
+
+	FanInCounter counter(job_system.GetWorkerCount());
+	for (uint32_t children : { 10000u, 100000u, 1000000u })
+	{
+		RunFanIn(job_system, children, nullptr);
+		RunFanIn(job_system, children, &counter);
+	}
+
+	job_system.Stop();
+	return 0;
+}
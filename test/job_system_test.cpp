@@ -2,17 +2,1333 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+#include <random>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
 
 #include "../include/job_system/job_system.hpp"
+#include "../include/job_system/task_group.hpp"
+#include "../include/job_system/strand.hpp"
+#include "../include/job_system/actor.hpp"
+#include "../include/job_system/channel.hpp"
+#include "../include/job_system/pipeline.hpp"
+#include "../include/job_system/parallel_for_file.hpp"
+#include "../include/job_system/async_file.hpp"
 #include "timer.hpp"
 
-int main()
+// 用法: JobSystemTest [--check]
+// 先运行正确性检查,--check时只运行检查,不运行后面的性能测试
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cout << __FILE__ << ":" << __LINE__ << ": CHECK failed: " << #condition << std::endl; \
+			++failures; \
+		} \
+	} while (0)
+
+// 等待条件成立,超时返回false.等待期间当前线程照常执行其他作业并推进时间轮,单工作线程时也不会卡住
+template<class F>
+bool WaitFor(JobSystem& job_system, F&& condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+{
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (!condition())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+
+		Job* tick = job_system.CreateJob([](Job*) {});
+		job_system.RunAfter(std::chrono::milliseconds(1), tick);
+		job_system.Wait(tick);
+	}
+	return true;
+}
+
+void Pause(JobSystem& job_system, std::chrono::milliseconds duration)
+{
+	WaitFor(job_system, []() { return false; }, duration);
+}
+
+// 在至少worker_count个工作线程上运行function,之后恢复原来的线程数;单核机器上也能覆盖多线程才会走到的路径
+template<class F>
+void WithWorkers(JobSystem& job_system, uint32_t worker_count, F&& function)
+{
+	uint32_t previous = job_system.GetWorkerCount();
+	if (previous >= worker_count)
+	{
+		function();
+		return;
+	}
+
+	job_system.Stop();
+	job_system.Start(worker_count);
+	function();
+	job_system.Stop();
+	job_system.Start(previous);
+}
+
+// 扇入计数器:子作业数量远超槽位数,且从不同线程创建,父作业在所有子作业执行后才完成
+void TestFanInCounter(JobSystem& job_system)
+{
+	constexpr uint32_t kSpawnerCount = 8;
+	constexpr uint32_t kChildrenPerSpawner = 500;
+
+	std::atomic_uint32_t executed = 0;
+	uint32_t executed_at_finish = 0;
+	FanInCounter counter(2);
+
+	Job storage;
+	Job* root = job_system.InitializeJob(&storage, [&job_system, &executed](Job* root)
+		{
+			for (uint32_t i = 0; i < kSpawnerCount; ++i)
+			{
+				job_system.Run(job_system.CreateJobAsChild(root, [&job_system, &executed](Job* spawner)
+					{
+						for (uint32_t j = 0; j < kChildrenPerSpawner; ++j)
+						{
+							job_system.Run(job_system.CreateJobAsChild(spawner->parent, [&executed](Job*)
+								{
+									std::this_thread::yield();
+									++executed;
+								}));
+						}
+						++executed;
+					}));
+			}
+		});
+	job_system.SetFanInCounter(root, &counter);
+
+	// 后续作业在父作业完成时投递,此时所有子作业都应已执行
+	Job* continuation = job_system.CreateJob([&executed, &executed_at_finish](Job*)
+		{
+			executed_at_finish = executed;
+		});
+	job_system.AddContinuation(root, continuation);
+
+	job_system.Run(root);
+	job_system.Wait(root);
+	job_system.Wait(continuation);
+	CHECK(executed == kSpawnerCount * (kChildrenPerSpawner + 1));
+	CHECK(executed_at_finish == kSpawnerCount * (kChildrenPerSpawner + 1));
+	CHECK(counter.IsIdle());
+}
+
+// 计数器:挂在计数器上的作业(含子作业)全部完成后Wait才返回;RunWhen的作业在计数器归零之后才执行
+void TestJobCounter(JobSystem& job_system)
+{
+	constexpr uint32_t kJobCount = 64;
+	constexpr uint32_t kChildCount = 4;
+
+	JobCounter counter;
+	std::atomic_uint32_t executed = 0;
+	uint32_t executed_before_gated = 0;
+	std::atomic_bool gated_ran = false;
+
+	auto work = [&job_system, &executed](Job* job)
+	{
+		for (uint32_t i = 0; i < kChildCount; ++i)
+		{
+			job_system.Run(job_system.CreateJobAsChild(job, [&executed](Job*)
+				{
+					std::this_thread::yield();
+					++executed;
+				}));
+		}
+		++executed;
+	};
+
+	// 第一个作业投递后就登记等待归零的作业,之后再投递其余作业
+	job_system.Run(job_system.CreateJob(work), &counter);
+	job_system.RunWhen(&counter, 0, job_system.CreateJob([&executed, &executed_before_gated, &gated_ran](Job*)
+		{
+			executed_before_gated = executed;
+			gated_ran = true;
+		}));
+	for (uint32_t i = 1; i < kJobCount; ++i)
+	{
+		job_system.Run(job_system.CreateJob(work), &counter);
+	}
+
+	job_system.Wait(&counter);
+	CHECK(executed == kJobCount * (kChildCount + 1));
+	CHECK(counter.GetValue() == 0);
+
+	CHECK(WaitFor(job_system, [&gated_ran]() { return gated_ran.load(); }));
+	CHECK(executed_before_gated == kJobCount * (kChildCount + 1));
+
+	// 计数器已经归零时RunWhen立即投递
+	std::atomic_bool ran = false;
+	job_system.RunWhen(&counter, 0, job_system.CreateJob([&ran](Job*) { ran = true; }));
+	CHECK(WaitFor(job_system, [&ran]() { return ran.load(); }));
+}
+
+// TaskGroup:Wait等到所有任务(含超出内联槽位和任务中继续Run的任务)执行完才返回,
+// Wait之后可以重复使用;任务抛出异常时取消组内其余任务,由Wait重新抛出
+void TestTaskGroup(JobSystem& job_system)
+{
+	constexpr uint32_t kTaskCount = TaskGroup::kInlineJobCount * 3;
+
+	TaskGroup group(job_system);
+	std::atomic_uint32_t executed = 0;
+	for (uint32_t round = 0; round < 2; ++round)
+	{
+		executed = 0;
+		for (uint32_t i = 0; i < kTaskCount; ++i)
+		{
+			group.Run([&group, &executed]()
+				{
+					for (uint32_t j = 0; j < TaskGroup::kInlineJobCount + 1; ++j)
+					{
+						group.Run([&executed]()
+							{
+								std::this_thread::yield();
+								++executed;
+							});
+					}
+					++executed;
+				});
+		}
+		group.Wait();
+		CHECK(executed == kTaskCount * (TaskGroup::kInlineJobCount + 2));
+	}
+
+	// 抛出异常的任务先投递一批任务;每个任务都要耗时,异常取消组时它们不可能全部执行完
+	constexpr uint32_t kSkippedCount = 100;
+	executed = 0;
+	group.Run([&group, &executed]()
+		{
+			for (uint32_t i = 0; i < kSkippedCount; ++i)
+			{
+				group.Run([&executed]()
+					{
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						++executed;
+					});
+			}
+			throw std::runtime_error("task");
+		});
+
+	bool caught = false;
+	try
+	{
+		group.Wait();
+	}
+	catch (const std::runtime_error&)
+	{
+		caught = true;
+	}
+	CHECK(caught);
+	CHECK(executed < kSkippedCount);
+	CHECK(!group.IsCancelled());
+
+	// 异常被Wait取走后组可以继续使用,不会再次抛出
+	executed = 0;
+	group.Run([&executed]() { ++executed; });
+	group.Wait();
+	CHECK(executed == 1);
+}
+
+// 取消:根作业的令牌被取消后,子树中还没开始的作业(含孙作业)都被跳过,根作业照常完成;
+// 令牌挂在父令牌下时,取消父令牌效果相同
+void TestCancellation(JobSystem& job_system)
+{
+	constexpr uint32_t kChildCount = 100;
+
+	// 每个子作业再创建一个孙作业,都要耗时,取消后不可能全部执行完
+	auto run_tree = [&job_system](CancellationToken* token, CancellationToken* cancel, std::atomic_uint32_t& executed)
+	{
+		std::atomic_bool continued = false;
+		Job* root = job_system.CreateJob([&job_system, &executed, cancel](Job* root)
+			{
+				for (uint32_t i = 0; i < kChildCount; ++i)
+				{
+					job_system.Run(job_system.CreateJobAsChild(root, [&job_system, &executed](Job* child)
+						{
+							job_system.Run(job_system.CreateJobAsChild(child, [&executed](Job*)
+								{
+									std::this_thread::sleep_for(std::chrono::milliseconds(1));
+									++executed;
+								}));
+							std::this_thread::sleep_for(std::chrono::milliseconds(1));
+							++executed;
+						}));
+				}
+				if (cancel)
+				{
+					cancel->Cancel();
+				}
+			});
+		job_system.SetCancellationToken(root, token);
+		job_system.AddContinuation(root, job_system.CreateJob([&continued](Job*) { continued = true; }));
+
+		job_system.Run(root);
+		job_system.Wait(root);
+		CHECK(WaitFor(job_system, [&continued]() { return continued.load(); }));
+	};
+
+	// 没有取消时整棵树都执行
+	CancellationToken token;
+	std::atomic_uint32_t executed = 0;
+	run_tree(&token, nullptr, executed);
+	CHECK(executed == kChildCount * 2);
+
+	executed = 0;
+	run_tree(&token, &token, executed);
+	CHECK(executed < kChildCount * 2);
+	CHECK(token.IsCancelled());
+
+	// 父令牌被取消,挂在子令牌上的作业树同样被跳过
+	CancellationToken parent;
+	CancellationToken child(&parent);
+	executed = 0;
+	run_tree(&child, &parent, executed);
+	CHECK(executed < kChildCount * 2);
+	CHECK(child.IsCancelled());
+
+	// 父令牌复位后子令牌不再视为取消,作业树完整执行
+	parent.Reset();
+	CHECK(!child.IsCancelled());
+	executed = 0;
+	run_tree(&child, nullptr, executed);
+	CHECK(executed == kChildCount * 2);
+}
+
+// 异常:子作业的异常由Wait(parent)重新抛出且只抛出一次;计数器上作业的异常由Wait(counter)抛出后清除
+void TestExceptions(JobSystem& job_system)
+{
+	auto throws = [](auto&& function)
+	{
+		try
+		{
+			function();
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	};
+
+	std::atomic_uint32_t executed = 0;
+	Job* parent = job_system.CreateJob([&job_system, &executed](Job* parent)
+		{
+			job_system.Run(job_system.CreateJobAsChild(parent, [](Job*)
+				{
+					throw std::runtime_error("child");
+				}));
+			job_system.Run(job_system.CreateJobAsChild(parent, [&executed](Job*)
+				{
+					++executed;
+				}));
+		});
+	job_system.Run(parent);
+	CHECK(throws([&job_system, parent]() { job_system.Wait(parent); }));
+	CHECK(!throws([&job_system, parent]() { job_system.Wait(parent); }));
+	CHECK(executed == 1);
+
+	// 抛出异常的是计数器上作业的子作业
+	JobCounter counter;
+	job_system.Run(job_system.CreateJob([&job_system](Job* job)
+		{
+			job_system.Run(job_system.CreateJobAsChild(job, [](Job*)
+				{
+					throw std::runtime_error("counter");
+				}));
+		}), &counter);
+	job_system.Run(job_system.CreateJob([&executed](Job*) { ++executed; }), &counter);
+	CHECK(throws([&job_system, &counter]() { job_system.Wait(&counter); }));
+	CHECK(counter.GetValue() == 0);
+	CHECK(executed == 2);
+	CHECK(!throws([&job_system, &counter]() { job_system.Wait(&counter); }));
+
+	// 清除后计数器可以继续使用
+	job_system.Run(job_system.CreateJob([&executed](Job*) { ++executed; }), &counter);
+	CHECK(!throws([&job_system, &counter]() { job_system.Wait(&counter); }));
+	CHECK(executed == 3);
+}
+
+// 时间轮:逐层下放后每个定时器恰好在到期的tick触发,不早也不晚
+void TestTimerWheelCascade()
 {
+	// 覆盖第0层,各层边界,以及超出最高层范围需要多次下放的定时器
+	const uint64_t expire_ticks[] = { 0, 1, 63, 64, 65, 127, 4095, 4096, 4097, 262143, 262144, 300000, (uint64_t(1) << 24) + 5 };
+
+	TimerWheel wheel;
+	for (uint64_t expire_tick : expire_ticks)
+	{
+		auto timer = new TimerWheel::Timer();
+		timer->expire_tick = expire_tick;
+		timer->period_ticks = 0;
+		timer->job = nullptr;
+		timer->token = nullptr;
+		wheel.Add(timer);
+	}
+
+	std::vector<uint64_t> fired;
+	auto on_expired = [&fired](TimerWheel::Timer* timer)
+	{
+		fired.push_back(timer->expire_tick);
+		return false;
+	};
+
+	for (size_t i = 0; i < std::size(expire_ticks); ++i)
+	{
+		uint64_t expire_tick = expire_ticks[i];
+		if (expire_tick > 0)
+		{
+			wheel.AdvanceTo(expire_tick - 1, on_expired);
+			CHECK(fired.size() == i);
+		}
+
+		wheel.AdvanceTo(expire_tick, on_expired);
+		CHECK(fired.size() == i + 1 && fired.back() == expire_tick);
+	}
+
+	// 周期定时器跨过第1层的边界后仍按周期触发
+	TimerWheel periodic_wheel;
+	auto timer = new TimerWheel::Timer();
+	timer->expire_tick = 10;
+	timer->period_ticks = 100;
+	timer->job = nullptr;
+	timer->token = nullptr;
+	periodic_wheel.Add(timer);
+
+	std::vector<uint64_t> periodic_fired;
+	uint64_t now = 0;
+	for (; now <= 1000; ++now)
+	{
+		periodic_wheel.AdvanceTo(now, [&periodic_fired, &now](TimerWheel::Timer*)
+			{
+				periodic_fired.push_back(now);
+				return periodic_fired.size() < 5;
+			});
+	}
+	CHECK((periodic_fired == std::vector<uint64_t>{ 10, 110, 210, 310, 410 }));
+
+	// 空闲很久之后添加的定时器:推进直接跳到当前时间,不逐个走过空闲的tick
+	TimerWheel idle_wheel;
+	const uint64_t idle_tick = uint64_t(1) << 32;
+	idle_wheel.AdvanceTo(idle_tick, on_expired);
+	timer = new TimerWheel::Timer();
+	timer->expire_tick = idle_tick + 10;
+	timer->period_ticks = 0;
+	timer->job = nullptr;
+	timer->token = nullptr;
+	idle_wheel.Add(timer);
+
+	fired.clear();
+	auto start = std::chrono::steady_clock::now();
+	idle_wheel.AdvanceTo(idle_tick + 9, on_expired);
+	CHECK(fired.empty());
+	idle_wheel.AdvanceTo(idle_tick + 10, on_expired);
+	CHECK(fired.size() == 1 && fired.back() == idle_tick + 10);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+}
+
+// RunAfter不早于延迟触发;RunEvery在令牌取消后停止
+void TestRunAfterAndRunEvery(JobSystem& job_system)
+{
+	// 100ms落在第1层,需要下放一次
+	auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration elapsed{};
+	Job* job = job_system.CreateJob([start, &elapsed](Job*)
+		{
+			elapsed = std::chrono::steady_clock::now() - start;
+		});
+	job_system.RunAfter(std::chrono::milliseconds(100), job);
+	job_system.Wait(job);
+	CHECK(elapsed >= std::chrono::milliseconds(100));
+	CHECK(elapsed < std::chrono::milliseconds(1000));
+
+	std::atomic_uint32_t ticks = 0;
+	CancellationToken token;
+	job_system.RunEvery(std::chrono::milliseconds(2), [&ticks](Job*)
+		{
+			++ticks;
+		}, &token);
+	CHECK(WaitFor(job_system, [&ticks]() { return ticks >= 3; }));
+
+	// 取消前已经在执行的那次可能还会计数,之后不应再有
+	token.Cancel();
+	Pause(job_system, std::chrono::milliseconds(20));
+	uint32_t stopped = ticks;
+	Pause(job_system, std::chrono::milliseconds(20));
+	CHECK(ticks == stopped);
+}
+
+// Strand:任务的异常交给on_exception,没有处理函数时由TakeException取走,后面的任务照常执行
+void TestStrandExceptions(JobSystem& job_system)
+{
+	Strand strand(job_system);
+	std::atomic_uint32_t executed = 0;
+	std::atomic_bool handled = false;
+
+	strand.Post([]() { throw std::runtime_error("handled"); }, [&handled](std::exception_ptr)
+		{
+			handled = true;
+		});
+	strand.Post([]() { throw std::runtime_error("unhandled"); });
+	strand.Post([&executed]() { ++executed; });
+	CHECK(WaitFor(job_system, [&strand]() { return strand.GetSize() == 0; }));
+
+	CHECK(handled);
+	CHECK(executed == 1);
+
+	std::string message;
+	try
+	{
+		if (std::exception_ptr exception = strand.TakeException())
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		message = e.what();
+	}
+	CHECK(message == "unhandled");
+	CHECK(strand.TakeException() == nullptr);
+}
+
+// Actor:Receive的异常交给OnException,之后的消息照常处理
+class FailingActor : public Actor<int>
+{
+public:
+	explicit FailingActor(JobSystem& job_system)
+		: Actor<int>(job_system)
+	{
+	}
+
+	std::atomic_uint32_t received = 0;
+	std::atomic_int32_t failed_message = 0;
+protected:
+	void Receive(int& message) override
+	{
+		if (message < 0)
+		{
+			throw std::runtime_error("negative");
+		}
+		++received;
+	}
+
+	void OnException(int& message, std::exception_ptr exception) override
+	{
+		failed_message = message;
+		Actor<int>::OnException(message, exception);
+	}
+};
+
+void TestActorExceptions(JobSystem& job_system)
+{
+	FailingActor actor(job_system);
+	actor.Send(1);
+	actor.Send(-7);
+	actor.Send(2);
+	CHECK(WaitFor(job_system, [&actor]() { return actor.GetMailboxSize() == 0; }));
+
+	CHECK(actor.received == 2);
+	CHECK(actor.failed_message == -7);
+	CHECK(actor.TakeException() != nullptr);
+	CHECK(actor.TakeException() == nullptr);
+}
+
+// Select与单通道接收者竞争:Select等待A和B,X只等待B.
+// 发送B唤醒了Select,随后发送A时Select已被唤醒;Select重试时取走A的数据,B的数据必须仍能唤醒X
+void TestSelectWakeup(JobSystem& job_system)
+{
+	struct Round
+	{
+		explicit Round(JobSystem& job_system)
+			: a(4, job_system)
+			, b(4, job_system)
+		{
+		}
+
+		Channel<int> a;
+		Channel<int> b;
+		std::atomic_uint32_t select_received = 0;
+		std::atomic_uint32_t receive_received = 0;
+	};
+
+	// 唤醒作业可能晚于断言执行,通道留到最后再销毁
+	std::vector<std::unique_ptr<Round>> rounds;
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		rounds.push_back(std::make_unique<Round>(job_system));
+		Round& round = *rounds.back();
+
+		Select({ round.a.OnReceive([&round](int) { ++round.select_received; }),
+			round.b.OnReceive([&round](int) { ++round.select_received; }) });
+		round.b.Receive([&round](int) { ++round.receive_received; });
+
+		round.b.Send(2);
+		round.a.Send(1);
+		CHECK(WaitFor(job_system, [&round]() { return round.select_received + round.receive_received == 2; }, std::chrono::milliseconds(500)));
+		CHECK(round.select_received == 1 && round.receive_received == 1);
+		if (failures)
+		{
+			break;
+		}
+	}
+	Pause(job_system, std::chrono::milliseconds(10));
+}
+
+// 流水线:有序串行阶段按输入顺序输出,串行阶段不并发;异常和取消能让Run返回,之后流水线可以再次运行
+void TestPipeline(JobSystem& job_system)
+{
+	constexpr int kItemCount = 5000;
+
+	int next = 0;
+	int throw_at = -1;
+	std::vector<int> output;
+	std::atomic_int32_t serial_inside = 0;
+	bool overlapped = false;
+
+	Pipeline<int> pipeline(job_system);
+	pipeline.SetInput([&next](int& item)
+		{
+			if (next >= kItemCount)
+			{
+				return false;
+			}
+			item = next++;
+			return true;
+		})
+		.AddStage(FilterMode::kParallel, [](int& item)
+		{
+			// 让令牌乱序到达后面的阶段
+			if (item % 7 == 0)
+			{
+				std::this_thread::yield();
+			}
+			item *= 2;
+		})
+		.AddStage(FilterMode::kSerialOutOfOrder, [&serial_inside, &overlapped](int&)
+		{
+			overlapped |= serial_inside++ != 0;
+			--serial_inside;
+		})
+		.AddStage(FilterMode::kSerialInOrder, [&output, &throw_at](int& item)
+		{
+			if (item / 2 == throw_at)
+			{
+				throw std::runtime_error("stage");
+			}
+			output.push_back(item / 2);
+		});
+
+	auto in_order = [&output]()
+	{
+		for (size_t i = 0; i < output.size(); ++i)
+		{
+			if (output[i] != static_cast<int>(i))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	pipeline.Run(16);
+	CHECK(output.size() == kItemCount);
+	CHECK(in_order());
+	CHECK(!overlapped);
+
+	// 有序阶段抛出异常:Run重新抛出,输入提前停止,异常之前的输出仍然有序
+	next = 0;
+	throw_at = 1000;
+	output.clear();
+	bool caught = false;
+	try
+	{
+		pipeline.Run(16);
+	}
+	catch (const std::runtime_error&)
+	{
+		caught = true;
+	}
+	CHECK(caught);
+	CHECK(next < kItemCount);
+	CHECK(output.size() == 1000 && in_order());
+
+	// 外层作业被取消:Run不抛出,提前结束
+	next = 0;
+	throw_at = -1;
+	output.clear();
+	CancellationToken outer;
+	Job* job = job_system.CreateJob([&pipeline](Job*)
+		{
+			pipeline.Run(16);
+		});
+	job_system.SetCancellationToken(job, &outer);
+	pipeline.AddStage(FilterMode::kSerialInOrder, [&outer](int& item)
+		{
+			if (item / 2 == 100)
+			{
+				outer.Cancel();
+			}
+		});
+	job_system.Run(job);
+	job_system.Wait(job);
+	CHECK(next < kItemCount);
+	CHECK(output.size() > 100 && output.size() < kItemCount && in_order());
+
+	// 异常和取消之后同一个流水线还能完整运行
+	next = 0;
+	output.clear();
+	outer.Reset();
+	pipeline.Run(16);
+	CHECK(output.size() == kItemCount);
+	CHECK(in_order());
+}
+
+// 按行切分文件:块边界总是落在行尾,跨块边界的记录完整地留在一个块里;没有结尾换行和空文件也能正确处理
+void TestParallelForFile(JobSystem& job_system)
+{
+	// 块里的每一行都应是完整的数字,被切断的记录会导致数字缺失或重复
+	auto parse_lines = [](std::string_view chunk)
+	{
+		std::vector<uint32_t> values;
+		while (!chunk.empty())
+		{
+			size_t end = std::min(chunk.find('\n'), chunk.size());
+			values.push_back(static_cast<uint32_t>(std::stoul(std::string(chunk.substr(0, end)))));
+			chunk.remove_prefix(std::min(end + 1, chunk.size()));
+		}
+		return values;
+	};
+
+	// "bbbbbbbbbb"跨过了第一个块的边界,整条留在第一个块里
+	std::string_view text = "a\nbbbbbbbbbb\ncc\nd\neeeee";
+	CHECK((SplitRecords(text, 4, FindNextLine) == std::vector<std::string_view>{ "a\nbbbbbbbbbb\n", "cc\nd\n", "eeeee" }));
+	CHECK((SplitRecords("a\nb\n", 2, FindNextLine) == std::vector<std::string_view>{ "a\n", "b\n" }));
+	CHECK(SplitRecords("", 4, FindNextLine).empty());
+
+	std::string path = (std::filesystem::temp_directory_path() / ("job_system_test_" + std::to_string(std::random_device()()) + ".txt")).string();
+	auto write_file = [&path](const std::string& content)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << content;
+	};
+
+	// 行的长度不同,块边界落在行中间;最后一行没有换行
+	constexpr uint32_t kLineCount = 10000;
+	std::string content;
+	for (uint32_t i = 0; i < kLineCount; ++i)
+	{
+		content += std::to_string(i);
+		if (i + 1 < kLineCount)
+		{
+			content += '\n';
+		}
+	}
+	write_file(content);
+
+	std::mutex mutex;
+	std::vector<uint32_t> values;
+	std::atomic_uint32_t chunk_count = 0;
+	CHECK(ParallelForFile(path, 64, [&](std::string_view chunk)
+		{
+			++chunk_count;
+			std::vector<uint32_t> chunk_values = parse_lines(chunk);
+			std::unique_lock lock(mutex);
+			values.insert(values.end(), chunk_values.begin(), chunk_values.end());
+		}, FindNextLine, job_system));
+	std::sort(values.begin(), values.end());
+	bool all_values = values.size() == kLineCount;
+	for (uint32_t i = 0; all_values && i < kLineCount; ++i)
+	{
+		all_values = values[i] == i;
+	}
+	CHECK(all_values);
+	CHECK(chunk_count > 1);
+
+	// 归约按块在文件中的顺序进行:每个块的第一行紧接着上一个块的最后一行
+	uint32_t next = 0;
+	uint64_t sum = 0;
+	bool in_order = true;
+	CHECK(ParallelForFileReduce(path, 64, parse_lines, [&](std::vector<uint32_t> chunk_values)
+		{
+			for (uint32_t value : chunk_values)
+			{
+				in_order &= value == next++;
+				sum += value;
+			}
+		}, FindNextLine, job_system));
+	CHECK(in_order && next == kLineCount);
+	CHECK(sum == uint64_t(kLineCount) * (kLineCount - 1) / 2);
+
+	// 空文件:打开成功,不调用处理函数和归约函数
+	write_file("");
+	bool called = false;
+	CHECK(ParallelForFile(path, 64, [&called](std::string_view) { called = true; }, FindNextLine, job_system));
+	CHECK(ParallelForFileReduce(path, 64, parse_lines, [&called](std::vector<uint32_t>) { called = true; }, FindNextLine, job_system));
+	CHECK(!called);
+
+	std::filesystem::remove(path);
+	CHECK(!ParallelForFile(path, 64, [](std::string_view) {}, FindNextLine, job_system));
+}
+
+// 异步文件读写:写入后读回的内容一致,读到文件末尾之后返回0;io_uring和阻塞线程池两条路径都要通过
+void TestAsyncFileRoundTrip(JobSystem& job_system)
+{
+	constexpr uint32_t kBlockSize = 4096;
+	constexpr uint32_t kBlockCount = 64;
+
+	std::string path = (std::filesystem::temp_directory_path() / ("job_system_test_" + std::to_string(std::random_device()()) + ".bin")).string();
+	for (bool use_io_uring : { false, true })
+	{
+#ifdef _WIN32
+		NativeFileHandle file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		CHECK(file != INVALID_HANDLE_VALUE);
+#else
+		NativeFileHandle file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		CHECK(file >= 0);
+#endif
+
+		std::vector<uint8_t> written(kBlockSize * kBlockCount);
+		for (size_t i = 0; i < written.size(); ++i)
+		{
+			written[i] = static_cast<uint8_t>(i * 131 + i / kBlockSize);
+		}
+
+		{
+			// 析构时等待所有请求完成
+			AsyncFileIo io(job_system, 16, use_io_uring);
+			CHECK(use_io_uring || !io.IsUsingIoUring());
+
+			// 请求数超过队列深度,提交时需要边收割边提交
+			std::atomic_uint32_t completed = 0;
+			std::atomic_uint32_t failed = 0;
+			auto on_complete = [&completed, &failed](int64_t result)
+			{
+				failed += result != kBlockSize;
+				++completed;
+			};
+			for (uint32_t i = 0; i < kBlockCount; ++i)
+			{
+				io.Write(file, written.data() + i * kBlockSize, kBlockSize, uint64_t(i) * kBlockSize, on_complete);
+			}
+			io.Submit();
+			CHECK(WaitFor(job_system, [&completed]() { return completed == kBlockCount; }));
+			CHECK(failed == 0);
+
+			std::vector<uint8_t> read(written.size());
+			completed = 0;
+			for (uint32_t i = 0; i < kBlockCount; ++i)
+			{
+				io.Read(file, read.data() + i * kBlockSize, kBlockSize, uint64_t(i) * kBlockSize, on_complete);
+			}
+			io.Submit();
+			CHECK(WaitFor(job_system, [&completed]() { return completed == kBlockCount; }));
+			CHECK(failed == 0);
+			CHECK(read == written);
+
+			std::atomic_int64_t eof_result = -1;
+			io.Read(file, read.data(), kBlockSize, written.size(), [&eof_result](int64_t result) { eof_result = result; });
+			io.Submit();
+			CHECK(WaitFor(job_system, [&eof_result]() { return eof_result != -1; }));
+			CHECK(eof_result == 0);
+		}
+
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		close(file);
+#endif
+	}
+	std::filesystem::remove(path);
+}
+
+// 阻塞区域:所有工作线程都阻塞在BlockingRegion中时,补偿线程仍然能让其他作业推进
+void TestBlockingRegion(JobSystem& job_system)
+{
+	constexpr uint32_t kProgressJobCount = 100;
+
+	uint32_t blocker_count = job_system.GetWorkerCount();
+	std::atomic_uint32_t blocked = 0;
+	std::atomic_uint32_t progressed = 0;
+	std::atomic_bool released = false;
+	std::atomic_uint32_t timed_out = 0;
+
+	// 阻塞的作业等待释放,超时后放弃,避免补偿失效时测试卡死
+	auto block = [&blocked, &released, &timed_out](Job*)
+	{
+		BlockingRegion region;
+		++blocked;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (!released)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				++timed_out;
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	};
+
+	// 所有工作线程都阻塞之后才推进,推进的作业只能由补偿线程执行
+	auto progress = [&job_system, &blocked, &progressed, &released, &timed_out, blocker_count](Job* job)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (blocked < blocker_count)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				++timed_out;
+				break;
+			}
+			std::this_thread::yield();
+		}
+
+		Job* parent = job_system.CreateJobAsChild(job, [](Job*) {});
+		for (uint32_t i = 0; i < kProgressJobCount; ++i)
+		{
+			job_system.Run(job_system.CreateJobAsChild(parent, [&progressed](Job*) { ++progressed; }));
+		}
+		job_system.Run(parent);
+		job_system.Wait(parent);
+		released = true;
+	};
+
+	Job* root = job_system.CreateJob([&job_system, &block, &progress, blocker_count](Job* root)
+		{
+			job_system.Run(job_system.CreateJobAsChild(root, progress));
+			for (uint32_t i = 0; i < blocker_count; ++i)
+			{
+				job_system.Run(job_system.CreateJobAsChild(root, block));
+			}
+		});
+	job_system.Run(root);
+	job_system.Wait(root);
+
+	CHECK(blocked == blocker_count);
+	CHECK(progressed == kProgressJobCount);
+	CHECK(timed_out == 0);
+}
+
+// 阻塞线程池:Stop等待作业执行完,并且join了所有线程,线程的thread_local析构都已完成;之后线程池可以继续使用
+struct BlockingThreadProbe
+{
+	static inline std::atomic_uint32_t constructed = 0;
+	static inline std::atomic_uint32_t destroyed = 0;
+
+	BlockingThreadProbe() { ++constructed; }
+
+	~BlockingThreadProbe()
+	{
+		// 拖慢线程退出,Stop没有join时析构一定还没完成
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		++destroyed;
+	}
+};
+
+void TestBlockingPoolStop()
+{
+	constexpr uint32_t kJobCount = 8;
+
+	std::atomic_uint32_t executed = 0;
+	BlockingPool pool([&executed](Job*)
+		{
+			thread_local BlockingThreadProbe probe;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			++executed;
+		});
+
+	std::vector<Job> jobs(kJobCount);
+	for (uint32_t round = 0; round < 2; ++round)
+	{
+		executed = 0;
+		for (Job& job : jobs)
+		{
+			pool.Push(&job);
+		}
+		CHECK(pool.GetThreadCount() > 1);
+
+		pool.Stop();
+		CHECK(executed == kJobCount);
+		CHECK(pool.GetThreadCount() == 0);
+		CHECK(BlockingThreadProbe::constructed > 0);
+		CHECK(BlockingThreadProbe::destroyed == BlockingThreadProbe::constructed);
+	}
+}
+
+// 按名字创建作业:同一块缓冲区先后写入不同的名字,得到的是各自的类别
+void TestJobCategoryNames(JobSystem& job_system)
+{
+	auto category_of = [&job_system](const char* name)
+	{
+		Job* job = job_system.CreateJob(name, [](Job*) {});
+		uint32_t category = job->category;
+		job_system.Run(job);
+		job_system.Wait(job);
+		return category;
+	};
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof(buffer), "test.category.a");
+	uint32_t a = category_of(buffer);
+	std::snprintf(buffer, sizeof(buffer), "test.category.b");
+	uint32_t b = category_of(buffer);
+	CHECK(a != b);
+	CHECK(JobCategoryRegistry::Get().GetName(a) == "test.category.a");
+	CHECK(JobCategoryRegistry::Get().GetName(b) == "test.category.b");
+
+	// 换回原来的名字,以及用字面量和JobCategory查找,都得到同一个类别
+	std::string name = "test.category.a";
+	CHECK(category_of(name.c_str()) == a);
+	CHECK(category_of("test.category.b") == b);
+	CHECK(JobCategory("test.category.a").GetId() == a);
+}
+
+// ParallelFor对每个下标恰好调用一次
+template<class S>
+bool VisitsEachIndexOnce(JobSystem& job_system, uint32_t count, const S& splitter)
+{
+	std::vector<std::atomic_uint32_t> hits(count);
+	std::function<void(std::atomic_uint32_t*, uint32_t)> visit = [](std::atomic_uint32_t* data, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			++data[i];
+		}
+	};
+
+	Job* job = job_system.ParallelFor(hits.data(), count, visit, splitter);
+	job_system.Run(job);
+	job_system.Wait(job);
+	return std::all_of(hits.begin(), hits.end(), [](const std::atomic_uint32_t& hit) { return hit == 1; });
+}
+
+// 各个分割器在空范围,单个元素,质数长度以及粒度上下的长度上都恰好覆盖一次
+void TestPartitionerCoverage(JobSystem& job_system)
+{
+	constexpr uint32_t kGrainSize = 16;
+	const uint32_t counts[] = { 0, 1, 2, kGrainSize - 1, kGrainSize, kGrainSize + 1, 97, 1009, 10007 };
+	for (uint32_t count : counts)
+	{
+		CHECK(VisitsEachIndexOnce(job_system, count, kGrainSize));
+		CHECK(VisitsEachIndexOnce(job_system, count, FixedPartitioner(kGrainSize)));
+		CHECK(VisitsEachIndexOnce(job_system, count, StaticPartitioner()));
+		CHECK(VisitsEachIndexOnce(job_system, count, AutoPartitioner()));
+		// 叶子目标耗时极短时几乎每个元素都会触发二分
+		CHECK(VisitsEachIndexOnce(job_system, count, AutoPartitioner(1)));
+	}
+}
+
+// 亲和分割:叶子永远不会落在同一个桶里,否则后执行的叶子会覆盖前一个叶子记录的工作线程;
+// 同一个分割器重放同一范围,以及换一个长度重新记录时,都恰好覆盖一次
+void TestAffinityPartitioner(JobSystem& job_system)
+{
+	// 按ParallelForJob的方式二分出全部叶子,每个叶子记为由不同的"工作线程"执行,再检查查到的亲和线程
+	bool distinct_buckets = true;
+	for (uint32_t worker_count = 1; worker_count <= 8; ++worker_count)
+	{
+		for (uint32_t count = 1; count < 600; ++count)
+		{
+			AffinityPartitioner partitioner = AffinityPartitioner().Begin(count, worker_count);
+			std::vector<std::pair<uint32_t, uint32_t>> leaves;
+			std::function<void(uint32_t, uint32_t)> split = [&](uint32_t offset, uint32_t count)
+			{
+				if (count > 1 && partitioner.ShouldSplit(PartitionContext{}, offset, count))
+				{
+					split(offset, count / 2);
+					split(offset + count / 2, count - count / 2);
+					return;
+				}
+				leaves.emplace_back(offset, count);
+			};
+			split(0, count);
+
+			for (uint32_t i = 0; i < leaves.size(); ++i)
+			{
+				PartitionContext context{ worker_count, i, 0, nullptr };
+				partitioner.Execute(context, leaves[i].first, leaves[i].second, []() {});
+			}
+			for (uint32_t i = 0; i < leaves.size(); ++i)
+			{
+				distinct_buckets &= partitioner.GetAffinity(leaves[i].first, leaves[i].second) == i;
+			}
+		}
+	}
+	CHECK(distinct_buckets);
+
+	AffinityPartitioner partitioner;
+	for (uint32_t count : { 1000u, 1000u, 1000u, 997u, 997u, 1u, 0u })
+	{
+		CHECK(VisitsEachIndexOnce(job_system, count, partitioner));
+	}
+}
+
+// 心跳分割:多个工作线程下原地分割恰好覆盖一次,嵌套的心跳循环也一样;
+// 空闲期间的窃取扑空不会留下过期的请求,让之后没有人能窃取的循环白白分出作业.需要至少两个工作线程
+void TestHeartbeatPartitioner(JobSystem& job_system)
+{
+	// 每个元素有一点工作量,循环持续足够久,其他工作线程会来窃取
+	std::atomic_uint32_t sink = 0;
+	auto busy = [&sink]()
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < 200; ++i)
+		{
+			value = value * 31 + i;
+		}
+		sink.fetch_add(value & 1, std::memory_order_relaxed);
+	};
+
+	constexpr uint32_t kCount = 20000;
+	std::vector<std::atomic_uint32_t> hits(kCount);
+	std::function<void(std::atomic_uint32_t*, uint32_t)> visit = [&busy](std::atomic_uint32_t* data, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			busy();
+			++data[i];
+		}
+	};
+	for (uint32_t count : { 0u, 1u, 97u, kCount })
+	{
+		CHECK(VisitsEachIndexOnce(job_system, count, HeartbeatPartitioner()));
+	}
+
+	Job* job = job_system.ParallelFor(hits.data(), kCount, visit, HeartbeatPartitioner(10000, 1000));
+	job_system.Run(job);
+	job_system.Wait(job);
+	CHECK(std::all_of(hits.begin(), hits.end(), [](const std::atomic_uint32_t& hit) { return hit == 1; }));
+
+	// 嵌套:外层每一行在作业内再对各列做一次心跳循环
+	constexpr uint32_t kRows = 64;
+	constexpr uint32_t kCols = 500;
+	std::vector<std::atomic_uint32_t> cells(kRows * kCols);
+	std::vector<uint32_t> rows(kRows);
+	for (uint32_t i = 0; i < kRows; ++i)
+	{
+		rows[i] = i;
+	}
+	std::function<void(uint32_t*, uint32_t)> visit_rows = [&job_system, &cells, &visit](uint32_t* row, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Job* inner = job_system.ParallelFor(cells.data() + row[i] * kCols, kCols, visit, HeartbeatPartitioner(10000, 1000));
+			job_system.Run(inner);
+			job_system.Wait(inner);
+		}
+	};
+	job = job_system.ParallelFor(rows.data(), kRows, visit_rows, HeartbeatPartitioner(10000, 1000));
+	job_system.Run(job);
+	job_system.Wait(job);
+	CHECK(std::all_of(cells.begin(), cells.end(), [](const std::atomic_uint32_t& hit) { return hit == 1; }));
+
+	// 空闲一段时间,让其他工作线程从本线程窃取扑空;之后让它们都忙起来,再执行一个心跳永远不会到期的循环.
+	// 没有人能窃取,循环不应分出任何作业,所有块都在根作业中执行
+	Pause(job_system, std::chrono::milliseconds(20));
+
+	std::atomic_uint32_t occupied = 0;
+	std::atomic_uint32_t finished = 0;
+	std::atomic_bool release = false;
+	uint32_t other_workers = job_system.GetWorkerCount() - 1;
+	for (uint32_t i = 0; i < other_workers; ++i)
+	{
+		job_system.Run(job_system.CreateJob([&occupied, &finished, &release](Job*)
+			{
+				++occupied;
+				while (!release)
+				{
+					std::this_thread::yield();
+				}
+				++finished;
+			}));
+	}
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (occupied < other_workers && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+	CHECK(occupied == other_workers);
+
+	std::mutex mutex;
+	std::vector<const Job*> executing_jobs;
+	std::function<void(std::atomic_uint32_t*, uint32_t)> record = [&job_system, &mutex, &executing_jobs, &busy](std::atomic_uint32_t* data, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			busy();
+			++data[i];
+		}
+		std::unique_lock lock(mutex);
+		executing_jobs.push_back(job_system.GetCurrentJob());
+	};
+	for (auto& hit : hits)
+	{
+		hit = 0;
+	}
+	job = job_system.ParallelFor(hits.data(), kCount, record, HeartbeatPartitioner(UINT64_MAX / 2, 1000));
+	job_system.Run(job);
+	job_system.Wait(job);
+	release = true;
+
+	CHECK(std::all_of(hits.begin(), hits.end(), [](const std::atomic_uint32_t& hit) { return hit == 1; }));
+	CHECK(std::all_of(executing_jobs.begin(), executing_jobs.end(), [job](const Job* executing) { return executing == job; }));
+	CHECK(WaitFor(job_system, [&finished, other_workers]() { return finished == other_workers; }));
+}
+
+// 二维/三维分块:每个分块把自己的元素加一,带行填充,层填充和元素间距的缓冲区里每个元素恰好被访问一次,
+// 填充和间距中的元素不被访问;分块的起始坐标和data指针一致
+using Cell = std::atomic_uint32_t;
+
+bool CoversTiles3D(JobSystem& job_system, uint32_t slices, uint32_t rows, uint32_t cols, TileSize tile, uint32_t stride, uint32_t row_padding, uint32_t slice_padding, bool as_2d)
+{
+	size_t row_elements = size_t(cols) * stride + row_padding;
+	size_t slice_elements = row_elements * rows + slice_padding;
+	std::vector<Cell> buffer(slice_elements * slices + 1);
+	Cell* base = buffer.data();
+	std::atomic_bool consistent = true;
+
+	auto mark = [base, row_elements, slice_elements, stride, &consistent](Cell* data, uint32_t slice_begin, uint32_t row_begin, uint32_t col_begin)
+	{
+		consistent = consistent && data == base + slice_begin * slice_elements + row_begin * row_elements + col_begin * stride;
+	};
+
+	Job* job = nullptr;
+	if (as_2d)
+	{
+		std::function<void(const Tile2D<Cell>&)> function = [&mark](const Tile2D<Cell>& range)
+		{
+			mark(range.data, 0, range.row_begin, range.col_begin);
+			for (uint32_t row = 0; row < range.rows; ++row)
+			{
+				for (uint32_t col = 0; col < range.cols; ++col)
+				{
+					++range.At(row, col);
+				}
+			}
+		};
+		job = job_system.ParallelFor2D(base, rows, cols, row_elements * sizeof(Cell), function, tile, stride * sizeof(Cell));
+	}
+	else
+	{
+		std::function<void(const Tile3D<Cell>&)> function = [&mark](const Tile3D<Cell>& range)
+		{
+			mark(range.data, range.slice_begin, range.row_begin, range.col_begin);
+			for (uint32_t slice = 0; slice < range.slices; ++slice)
+			{
+				for (uint32_t row = 0; row < range.rows; ++row)
+				{
+					for (uint32_t col = 0; col < range.cols; ++col)
+					{
+						++range.At(slice, row, col);
+					}
+				}
+			}
+		};
+		job = job_system.ParallelFor3D(base, slices, rows, cols, slice_elements * sizeof(Cell), row_elements * sizeof(Cell), function, tile, stride * sizeof(Cell));
+	}
+	job_system.Run(job);
+	job_system.Wait(job);
+
+	bool covered = true;
+	for (size_t i = 0; i < buffer.size(); ++i)
+	{
+		bool inside = i < slice_elements * slices && i % slice_elements < row_elements * rows;
+		if (inside)
+		{
+			size_t in_row = i % slice_elements % row_elements;
+			inside = in_row % stride == 0 && in_row / stride < cols;
+		}
+		covered &= buffer[i] == (inside ? 1u : 0u);
+	}
+	return covered && consistent;
+}
+
+void TestParallelForTiles(JobSystem& job_system)
+{
+	// 尺寸不是分块或外层分块的整数倍;2048x2048会分出多个外层分块,每个外层分块内有多个分块
+	CHECK(CoversTiles3D(job_system, 1, 0, 10, TileSize(), 1, 0, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 1, 1, TileSize(), 1, 0, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 37, 1001, TileSize(), 1, 3, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 37, 1001, TileSize(), 3, 5, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 2048, 2048, TileSize(), 1, 0, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 1000, 777, TileSize(), 2, 1, 0, true));
+
+	// 用户指定的分块,以及只指定一部分维度
+	CHECK(CoversTiles3D(job_system, 1, 100, 103, TileSize{ 0, 7, 5 }, 1, 2, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 100, 103, TileSize{ 0, 0, 9 }, 2, 0, 0, true));
+	CHECK(CoversTiles3D(job_system, 1, 513, 129, TileSize{ 0, 64, 64 }, 1, 7, 0, true));
+
+	CHECK(CoversTiles3D(job_system, 0, 5, 5, TileSize(), 1, 0, 0, false));
+	CHECK(CoversTiles3D(job_system, 3, 17, 29, TileSize(), 1, 3, 11, false));
+	CHECK(CoversTiles3D(job_system, 9, 33, 70, TileSize(), 2, 1, 5, false));
+	CHECK(CoversTiles3D(job_system, 64, 65, 66, TileSize(), 1, 0, 0, false));
+	CHECK(CoversTiles3D(job_system, 9, 33, 70, TileSize{ 2, 3, 5 }, 1, 4, 9, false));
+	CHECK(CoversTiles3D(job_system, 130, 9, 300, TileSize{ 3, 0, 0 }, 1, 0, 0, false));
+}
+
+int main(int argc, char** argv)
+{
+	bool check_only = argc > 1 && std::string(argv[1]) == "--check";
+
 	std::atomic_uint32_t jobs = 0;
 
 	auto& job_system = JobSystem::Get();
 	std::vector<float> vec(500000, 10);
 	job_system.Start(std::thread::hardware_concurrency());
+
+	TestFanInCounter(job_system);
+	TestJobCounter(job_system);
+	TestTaskGroup(job_system);
+	TestCancellation(job_system);
+	TestExceptions(job_system);
+	TestTimerWheelCascade();
+	TestRunAfterAndRunEvery(job_system);
+	TestStrandExceptions(job_system);
+	TestActorExceptions(job_system);
+	TestSelectWakeup(job_system);
+	TestPipeline(job_system);
+	TestParallelForFile(job_system);
+	TestAsyncFileRoundTrip(job_system);
+	TestBlockingRegion(job_system);
+	TestBlockingPoolStop();
+	TestJobCategoryNames(job_system);
+	TestPartitionerCoverage(job_system);
+	TestAffinityPartitioner(job_system);
+	TestParallelForTiles(job_system);
+	WithWorkers(job_system, 4, [&job_system]()
+		{
+			TestPartitionerCoverage(job_system);
+			TestAffinityPartitioner(job_system);
+			TestHeartbeatPartitioner(job_system);
+			TestParallelForTiles(job_system);
+		});
+	if (failures)
+	{
+		std::cout << failures << " checks failed" << std::endl;
+	}
+	else
+	{
+		std::cout << "all checks passed" << std::endl;
+	}
+	if (check_only)
+	{
+		job_system.Stop();
+		return failures ? 1 : 0;
+	}
+
 	std::cout << "begin" << std::endl;
 	{
 		Timer t("time");
@@ -38,5 +1354,5 @@ int main()
 
 	job_system.Stop();
 	system("pause");
-	return 0;
-}
\ No newline at end of file
+	return failures ? 1 : 0;
+}
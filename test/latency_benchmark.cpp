@@ -0,0 +1,149 @@
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+
+#include "../include/job_system/job_system.hpp"
+
+// 排队延迟基准:外部线程和工作线程以固定速率投递作业,统计Run到Execute开始之间的延迟
+// 用法: LatencyBenchmark [--workers N] [--rate jobs/s] [--duration ms] [--work ns]
+// 外部线程按间隔逐个投递,每4个中有1个用RunOn投递到指定工作线程;工作线程每毫秒由定时作业成批投递
+
+using Clock = std::chrono::steady_clock;
+
+void Spin(uint32_t ns)
+{
+	auto end = Clock::now() + std::chrono::nanoseconds(ns);
+	while (Clock::now() < end) {}
+}
+
+void PrintRow(const std::string& name, const LatencyHistogram& histogram)
+{
+	std::cout << std::left << std::setw(16) << name << std::right
+		<< std::setw(10) << histogram.GetCount()
+		<< std::fixed << std::setprecision(2)
+		<< std::setw(12) << histogram.GetMean() / 1000.0
+		<< std::setw(12) << histogram.GetPercentile(50) / 1000.0
+		<< std::setw(12) << histogram.GetPercentile(99) / 1000.0
+		<< std::setw(12) << histogram.GetPercentile(99.9) / 1000.0
+		<< std::setw(12) << histogram.GetMax() / 1000.0 << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t workers = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t rate = 20000;
+	uint32_t duration_ms = 2000;
+	uint32_t work_ns = 1000;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--workers") == 0)
+		{
+			workers = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--rate") == 0)
+		{
+			rate = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--duration") == 0)
+		{
+			duration_ms = std::max(1, atoi(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--work") == 0)
+		{
+			work_ns = std::max(0, atoi(argv[i + 1]));
+		}
+	}
+
+	auto& job_system = JobSystem::Get();
+	job_system.Start(workers);
+	job_system.EnableLatencyTracking(true);
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(duration_ms);
+	auto work = [work_ns](Job*) { Spin(work_ns); };
+
+	// 所有投递的作业都是root的子作业,外部线程投递结束后才运行root,主线程等待root即可等到全部完成
+	Job* root = job_system.CreateJob([](Job*) {});
+
+	// 工作线程上的投递:定时作业每毫秒投递一批,下一次定时在本次结束前创建,保证root不会提前完成
+	uint32_t batch = std::max(1u, rate / 1000);
+	std::function<void(Job*)> tick = [&](Job*)
+	{
+		for (uint32_t i = 0; i < batch; ++i)
+		{
+			job_system.Run(job_system.CreateJobAsChild(root, work));
+		}
+
+		if (Clock::now() < deadline)
+		{
+			job_system.RunAfter(std::chrono::milliseconds(1), job_system.CreateJobAsChild(root, tick));
+		}
+	};
+	job_system.Run(job_system.CreateJobAsChild(root, tick));
+
+	// 外部线程上的投递
+	std::thread producer([&]()
+	{
+		auto interval = std::chrono::nanoseconds(1000000000ull / rate);
+		auto next = Clock::now();
+		for (uint32_t i = 0; next < deadline; ++i)
+		{
+			std::this_thread::sleep_until(next);
+			next += interval;
+
+			Job* job = job_system.CreateJobAsChild(root, work);
+			if (i % 4 == 3)
+			{
+				job_system.RunOn(i % job_system.GetWorkerCount(), job);
+			}
+			else
+			{
+				job_system.Run(job);
+			}
+		}
+		job_system.Run(root);
+	});
+
+	job_system.Wait(root);
+	producer.join();
+
+	LatencyStats stats = job_system.GetLatencyStats();
+	job_system.Stop();
+
+	std::cout << "workers " << workers << ", rate " << rate << " jobs/s per producer, work " << work_ns << " ns, queueing delay in us" << std::endl;
+	std::cout << std::left << std::setw(16) << "source" << std::right
+		<< std::setw(10) << "count" << std::setw(12) << "mean" << std::setw(12) << "p50"
+		<< std::setw(12) << "p99" << std::setw(12) << "p999" << std::setw(12) << "max" << std::endl;
+
+	const char* source_names[] = { "worker", "external", "affinity", "blocking" };
+	for (uint32_t source = 0; source < static_cast<uint32_t>(JobSource::kCount); ++source)
+	{
+		if (stats.sources[source].GetCount())
+		{
+			PrintRow(source_names[source], stats.sources[source]);
+		}
+	}
+	PrintRow("total", stats.total);
+
+	for (size_t i = 0; i < stats.workers.size(); ++i)
+	{
+		LatencyHistogram histogram;
+		for (const LatencyHistogram& source : stats.workers[i])
+		{
+			histogram.Merge(source);
+		}
+
+		if (histogram.GetCount())
+		{
+			PrintRow(i + 1 == stats.workers.size() ? std::string("non-worker") : "worker " + std::to_string(i), histogram);
+		}
+	}
+
+	return 0;
+}